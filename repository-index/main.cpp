@@ -0,0 +1,192 @@
+// Builds a repository index from a directory of manifests:
+//
+//   repository-index <repository directory> <output.elpr> [none|gzip|zstd]
+//
+// Every manifest.json below the directory becomes an entry, relative icons
+// up to kMaxThumbnailSize are embedded.
+
+#include "RepositoryIndex.hpp"
+
+#include <nlohmann/json.hpp>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+static constexpr std::uintmax_t kMaxThumbnailSize = 256 * 1024;
+
+static std::optional<std::string> readFile(const std::filesystem::path &path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    return {};
+  }
+
+  return std::string(std::istreambuf_iterator<char>(input), {});
+}
+
+static void addThumbnails(RepositoryIndex &index,
+                          const std::filesystem::path &root,
+                          const std::string &entryPath,
+                          const Manifest &manifest) {
+  auto icon = std::string_view(manifest.icon);
+  if (!icon.empty() && !icon.contains("://") &&
+      std::filesystem::path(icon).is_relative()) {
+    auto key = RepositoryIndex::thumbnailKey(entryPath, icon);
+    auto path = root / key;
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (!ec && size <= kMaxThumbnailSize && !index.thumbnails.contains(key)) {
+      if (auto bytes = readFile(path)) {
+        index.thumbnails.emplace(std::move(key), std::move(*bytes));
+      }
+    }
+  }
+
+  for (auto &package : manifest.contributes.packages) {
+    addThumbnails(index, root, entryPath, package);
+  }
+}
+
+static std::optional<std::string> compress(Compression compression,
+                                           std::string_view payload) {
+  if (compression == Compression::None) {
+    return std::string(payload);
+  }
+
+  if (compression == Compression::Zstd) {
+#ifdef HAVE_ZSTD
+    std::string result(ZSTD_compressBound(payload.size()), '\0');
+    auto size = ZSTD_compress(result.data(), result.size(), payload.data(),
+                              payload.size(), 19);
+    if (ZSTD_isError(size)) {
+      return {};
+    }
+    result.resize(size);
+    return result;
+#else
+    return {};
+#endif
+  }
+
+  z_stream stream{};
+  // 16 writes a gzip header
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return {};
+  }
+
+  std::string result(deflateBound(&stream, payload.size()), '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(payload.data()));
+  stream.avail_in = static_cast<uInt>(payload.size());
+  stream.next_out = reinterpret_cast<Bytef *>(result.data());
+  stream.avail_out = static_cast<uInt>(result.size());
+
+  auto ret = deflate(&stream, Z_FINISH);
+  result.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (ret != Z_STREAM_END) {
+    return {};
+  }
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    std::fprintf(stderr,
+                 "usage: %s <repository directory> <output.elpr> "
+                 "[none|gzip|zstd]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::filesystem::path root = argv[1];
+  std::filesystem::path output = argv[2];
+
+#ifdef HAVE_ZSTD
+  auto compression = Compression::Zstd;
+#else
+  auto compression = Compression::Gzip;
+#endif
+
+  if (argc == 4) {
+    auto name = std::string_view(argv[3]);
+    if (name == "none") {
+      compression = Compression::None;
+    } else if (name == "gzip") {
+      compression = Compression::Gzip;
+    } else if (name == "zstd") {
+      compression = Compression::Zstd;
+    } else {
+      std::fprintf(stderr, "unknown compression '%s'\n", argv[3]);
+      return 1;
+    }
+  }
+
+  RepositoryIndex index;
+
+  std::error_code ec;
+  for (auto &file : std::filesystem::recursive_directory_iterator(root, ec)) {
+    if (!file.is_regular_file() || file.path().filename() != "manifest.json") {
+      continue;
+    }
+
+    auto bytes = readFile(file.path());
+    auto json = nlohmann::json::parse(bytes.value_or(""), nullptr, false);
+    if (json.is_discarded()) {
+      std::fprintf(stderr, "failed to parse '%s'\n", file.path().c_str());
+      return 1;
+    }
+
+    auto &entry = index.entries.emplace_back();
+    entry.path = std::filesystem::relative(file.path().parent_path(), root)
+                     .generic_string();
+
+    try {
+      entry.manifest = json.get<Manifest>();
+    } catch (const std::exception &ex) {
+      std::fprintf(stderr, "invalid manifest '%s': %s\n", file.path().c_str(),
+                   ex.what());
+      return 1;
+    }
+
+    addThumbnails(index, root, entry.path, entry.manifest);
+  }
+
+  if (ec) {
+    std::fprintf(stderr, "failed to read '%s': %s\n", root.c_str(),
+                 ec.message().c_str());
+    return 1;
+  }
+
+  auto payload = index.encodePayload();
+  auto compressed = compress(compression, payload);
+  if (!compressed) {
+    std::fprintf(stderr, "failed to compress the index\n");
+    return 1;
+  }
+
+  std::ofstream out(output, std::ios::binary | std::ios::trunc);
+  out << RepositoryIndex::encodeHeader(compression, payload.size())
+      << *compressed;
+  if (!out) {
+    std::fprintf(stderr, "failed to write '%s'\n", output.c_str());
+    return 1;
+  }
+
+  std::printf("%zu manifests, %zu thumbnails, %zu bytes\n",
+              index.entries.size(), index.thumbnails.size(),
+              compressed->size());
+  return 0;
+}
@@ -1,7 +1,11 @@
 #pragma once
 #include "ELP.hpp"
 #include "Manifest.hpp"
-#include "UiFile.hpp"
+#include "MethodCall.hpp"
+#include "MethodTable.hpp"
+#include "UiSchemaCache.hpp"
+#include "Url.hpp"
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 
@@ -12,34 +16,75 @@ using NotificationArgs = nlohmann::json;
 class Context;
 class Alternative {
   Manifest m_manifest;
-  IdToSchemaMap m_uiSchemaMap;
-  std::unique_ptr<SchemaNode> m_uiRoot;
+  UiSchemaCache *m_uiCache = nullptr;
+  Url m_uiUrl;
   std::mutex m_mutex;
 
+  std::shared_ptr<const UiSchema> getUiSchema() {
+    std::lock_guard lock(m_mutex);
+    if (m_uiCache == nullptr || m_uiUrl.empty()) {
+      return nullptr;
+    }
+    return m_uiCache->get(m_uiUrl);
+  }
+
 public:
-  Alternative(Manifest manifest) : m_manifest(std::move(manifest)) {}
+  Alternative(Manifest manifest) : m_manifest(std::move(manifest)) {
+    // manifests resolved by Context are precomputed already
+    if (m_manifest.cachedId.empty()) {
+      m_manifest.precompute();
+    }
+  }
   virtual ~Alternative() = default;
 
-  void setUiSchema(std::unique_ptr<SchemaNode> uiRoot,
-                   IdToSchemaMap uiSchemaMap) {
+  // the ui file is parsed by cache on the first lookup
+  void setUiSource(UiSchemaCache *cache, Url url) {
     std::lock_guard lock(m_mutex);
-    m_uiRoot = std::move(uiRoot);
-    m_uiSchemaMap = std::move(uiSchemaMap);
+    m_uiCache = cache;
+    m_uiUrl = std::move(url);
   }
 
-  SchemaNode *findUiSchema(std::string_view id) {
-    std::lock_guard lock(m_mutex);
-    if (auto it = m_uiSchemaMap.find(id); it != m_uiSchemaMap.end()) {
-      return it->second;
+  // the returned node keeps the whole schema alive, nullptr if the alternative
+  // has no such schema or a remote ui file is not fetched yet
+  std::shared_ptr<const SchemaNode> findUiSchema(std::string_view id) {
+    auto schema = getUiSchema();
+    if (schema == nullptr) {
+      return nullptr;
+    }
+
+    if (auto node = schema->find(id)) {
+      return {schema, node};
     }
     return nullptr;
   }
 
+  void prefetchUiSchema() {
+    std::lock_guard lock(m_mutex);
+    if (m_uiCache != nullptr && !m_uiUrl.empty()) {
+      m_uiCache->prefetch(m_uiUrl);
+    }
+  }
+
   virtual void
   callMethod(Context &context, std::string_view name, MethodCallArgs args,
              std::move_only_function<void(MethodCallResult)> responseHandler) {
     responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
   }
+  // alternatives with dispatch tables override this to skip the name lookup
+  virtual void callMethodById(
+      Context &context, MethodId method, MethodCallArgs args,
+      std::move_only_function<void(MethodCallResult)> responseHandler) {
+    callMethod(context, getMethodName(method), std::move(args),
+               std::move(responseHandler));
+  }
+  // stopToken is requested once the caller no longer waits for the result,
+  // alternatives that do work in the background should abandon it then
+  virtual void callMethodAsync(
+      Context &context, std::string_view name, MethodCallArgs args,
+      std::stop_token stopToken,
+      std::move_only_function<void(MethodCallResult)> responseHandler) {
+    callMethod(context, name, std::move(args), std::move(responseHandler));
+  }
   virtual void handleNotification(Context &context, std::string_view name,
                                   NotificationArgs args) {}
   virtual std::error_code activate(Context &context) { return {}; }
@@ -49,5 +94,13 @@ public:
     return manifest().match(requirements);
   }
 
+  bool match(const InternedRequirements &requirements) const {
+    return manifest().match(requirements);
+  }
+
+  // id of this alternative, groups keep their own id while manifest() returns
+  // the selected alternative
+  const ManifestId &id() const { return m_manifest.cachedId; }
+
   virtual const Manifest &manifest() const { return m_manifest; }
 };
@@ -2,7 +2,7 @@
 #include "Context.hpp"
 
 std::vector<std::shared_ptr<Alternative>>
-AlternativeGroup::find(const AlternativeRequirements &requirements) {
+AlternativeGroup::find(const InternedRequirements &requirements) {
   std::vector<std::shared_ptr<Alternative>> result;
 
   for (auto &candidate : candidates) {
@@ -19,13 +19,7 @@ void AlternativeGroup::remove(const std::shared_ptr<Alternative> &alternative) {
     selected = nullptr;
   }
 
-  for (auto it = candidates.begin(); it != candidates.end(); ++it) {
-    if (it->get() == alternative.get()) {
-      it = candidates.erase(it);
-    } else {
-      ++it;
-    }
-  }
+  std::erase(candidates, alternative);
 }
 
 void AlternativeGroup::callMethod(
@@ -41,6 +35,35 @@ void AlternativeGroup::callMethod(
                           std::move(responseHandler));
 }
 
+void AlternativeGroup::callMethodById(
+    Context &context, MethodId method, MethodCallArgs args,
+    std::move_only_function<void(MethodCallResult)> responseHandler) {
+  if (selected != nullptr) {
+    selected->callMethodById(context, method, std::move(args),
+                             std::move(responseHandler));
+    return;
+  }
+
+  Alternative::callMethodById(context, method, std::move(args),
+                              std::move(responseHandler));
+}
+
+void AlternativeGroup::callMethodAsync(
+    Context &context, std::string_view name, MethodCallArgs args,
+    std::stop_token stopToken,
+    std::move_only_function<void(MethodCallResult)> responseHandler) {
+  if (selected != nullptr) {
+    selected->callMethodAsync(context, name, std::move(args),
+                              std::move(stopToken),
+                              std::move(responseHandler));
+    return;
+  }
+
+  Alternative::callMethodAsync(context, name, std::move(args),
+                               std::move(stopToken),
+                               std::move(responseHandler));
+}
+
 void AlternativeGroup::handleNotification(Context &context,
                                           std::string_view name,
                                           NotificationArgs args) {
@@ -16,15 +16,21 @@ struct AlternativeGroup final : Alternative {
 
   std::vector<std::shared_ptr<Alternative>>
   getSelectedOrFind(const AlternativeRequirements &requirements) {
-    if (selected == nullptr || !selected->match(requirements)) {
-      return find(requirements);
+    InternedRequirements internedRequirements(requirements);
+    if (selected == nullptr || !selected->match(internedRequirements)) {
+      return find(internedRequirements);
     }
 
     return {selected};
   }
 
   std::vector<std::shared_ptr<Alternative>>
-  find(const AlternativeRequirements &requirements);
+  find(const AlternativeRequirements &requirements) {
+    return find(InternedRequirements(requirements));
+  }
+
+  std::vector<std::shared_ptr<Alternative>>
+  find(const InternedRequirements &requirements);
 
   void select(std::shared_ptr<Alternative> selection) { selected = selection; }
 
@@ -48,6 +54,13 @@ struct AlternativeGroup final : Alternative {
   void callMethod(
       Context &context, std::string_view name, MethodCallArgs args,
       std::move_only_function<void(MethodCallResult)> responseHandler) override;
+  void callMethodById(
+      Context &context, MethodId method, MethodCallArgs args,
+      std::move_only_function<void(MethodCallResult)> responseHandler) override;
+  void callMethodAsync(
+      Context &context, std::string_view name, MethodCallArgs args,
+      std::stop_token stopToken,
+      std::move_only_function<void(MethodCallResult)> responseHandler) override;
   void handleNotification(Context &context, std::string_view name,
                           NotificationArgs args) override;
   std::error_code activate(Context &context) override;
@@ -0,0 +1,241 @@
+#include "AlternativeIndex.hpp"
+#include "Alternative.hpp"
+
+#include <algorithm>
+#include <span>
+
+std::uint32_t
+AlternativeIndex::getOrCreateEntry(const std::shared_ptr<Alternative> &alt) {
+  auto [it, inserted] = m_ids.try_emplace(
+      alt.get(), static_cast<std::uint32_t>(m_entries.size()));
+
+  if (inserted) {
+    m_entries.push_back({.alternative = alt});
+  }
+
+  return it->second;
+}
+
+void AlternativeIndex::addKey(std::uint32_t id, Key key) {
+  auto &keys = m_entries[id].keys;
+  if (std::find(keys.begin(), keys.end(), key) != keys.end()) {
+    return;
+  }
+  keys.push_back(key);
+
+  // sequence numbers only grow, so this is an append unless an existing
+  // alternative joins a new group
+  auto &posting = m_postings[key];
+  posting.insert(std::upper_bound(posting.begin(), posting.end(), id), id);
+}
+
+void AlternativeIndex::removeKey(std::uint32_t id, Key key) {
+  auto postingIt = m_postings.find(key);
+  if (postingIt == m_postings.end()) {
+    return;
+  }
+
+  auto &posting = postingIt->second;
+  auto it = std::lower_bound(posting.begin(), posting.end(), id);
+  if (it != posting.end() && *it == id) {
+    posting.erase(it);
+  }
+
+  if (posting.empty()) {
+    m_postings.erase(postingIt);
+  }
+}
+
+void AlternativeIndex::add(const std::shared_ptr<Alternative> &alternative) {
+  auto id = getOrCreateEntry(alternative);
+  auto &manifest = alternative->manifest();
+
+  addKey(id, makeKey(KeyKind::All));
+
+  if (manifest.nameAtom != kNullAtom) {
+    addKey(id, makeKey(KeyKind::Name, manifest.nameAtom));
+  }
+
+  for (auto atom : manifest.capabilityAtoms) {
+    addKey(id, makeKey(KeyKind::Capability, atom));
+  }
+  for (auto atom : manifest.contributes.alternativeAtoms) {
+    addKey(id, makeKey(KeyKind::Alternative, atom));
+  }
+  for (auto atom : manifest.contributes.viewAtoms) {
+    addKey(id, makeKey(KeyKind::View, atom));
+  }
+  for (auto atom : manifest.contributes.methodAtoms) {
+    addKey(id, makeKey(KeyKind::Method, atom));
+  }
+
+  if (!manifest.source.empty()) {
+    addKey(id, makeKey(KeyKind::HasSource));
+  }
+  if (manifest.launch) {
+    addKey(id, makeKey(KeyKind::HasLaunch));
+  }
+  if (manifest.install) {
+    addKey(id, makeKey(KeyKind::HasInstall));
+  }
+  if (manifest.download) {
+    addKey(id, makeKey(KeyKind::HasDownload));
+  }
+}
+
+void AlternativeIndex::remove(const std::shared_ptr<Alternative> &alternative) {
+  auto it = m_ids.find(alternative.get());
+  if (it == m_ids.end()) {
+    return;
+  }
+
+  auto id = it->second;
+  m_ids.erase(it);
+
+  auto &entry = m_entries[id];
+  for (auto key : entry.keys) {
+    removeKey(id, key);
+  }
+
+  // sequence numbers keep insertion order, so the entry stays as a tombstone
+  // until enough of them pile up to renumber the live ones
+  entry = {};
+  ++m_tombstones;
+
+  if (m_tombstones >= kMinCompactTombstones &&
+      m_tombstones * 2 >= m_entries.size()) {
+    compact();
+  }
+}
+
+void AlternativeIndex::compact() {
+  std::vector<Entry> entries;
+  entries.reserve(m_entries.size() - m_tombstones);
+  m_ids.clear();
+  m_postings.clear();
+
+  for (auto &entry : m_entries) {
+    if (entry.alternative == nullptr) {
+      continue;
+    }
+
+    auto id = static_cast<std::uint32_t>(entries.size());
+    m_ids.emplace(entry.alternative.get(), id);
+    for (auto key : entry.keys) {
+      // ids are visited in order, so every posting stays sorted
+      m_postings[key].push_back(id);
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  m_entries = std::move(entries);
+  m_tombstones = 0;
+}
+
+void AlternativeIndex::addToGroup(
+    Atom group, const std::shared_ptr<Alternative> &alternative) {
+  // group queries with requirements intersect the manifest keys too
+  add(alternative);
+  addKey(getOrCreateEntry(alternative), makeKey(KeyKind::Group, group));
+}
+
+void AlternativeIndex::removeFromGroup(
+    Atom group, const std::shared_ptr<Alternative> &alternative) {
+  auto it = m_ids.find(alternative.get());
+  if (it == m_ids.end()) {
+    return;
+  }
+
+  auto key = makeKey(KeyKind::Group, group);
+  auto &keys = m_entries[it->second].keys;
+  if (auto keyIt = std::find(keys.begin(), keys.end(), key);
+      keyIt != keys.end()) {
+    keys.erase(keyIt);
+    removeKey(it->second, key);
+  }
+}
+
+std::vector<std::shared_ptr<Alternative>>
+AlternativeIndex::find(const InternedRequirements &requirements) const {
+  return query({makeKey(KeyKind::All)}, requirements);
+}
+
+std::vector<std::shared_ptr<Alternative>>
+AlternativeIndex::findInGroup(Atom group,
+                              const InternedRequirements &requirements) const {
+  return query({makeKey(KeyKind::Group, group)}, requirements);
+}
+
+std::vector<std::shared_ptr<Alternative>>
+AlternativeIndex::findByKey(KeyKind kind, Atom atom) const {
+  return query({makeKey(kind, atom)}, {});
+}
+
+std::vector<std::shared_ptr<Alternative>>
+AlternativeIndex::query(std::vector<Key> keys,
+                        const InternedRequirements &requirements) const {
+  if (requirements.name != kNullAtom) {
+    keys.push_back(makeKey(KeyKind::Name, requirements.name));
+  }
+  for (auto atom : requirements.capabilities) {
+    keys.push_back(makeKey(KeyKind::Capability, atom));
+  }
+  for (auto atom : requirements.alternatives) {
+    keys.push_back(makeKey(KeyKind::Alternative, atom));
+  }
+  for (auto atom : requirements.methods) {
+    keys.push_back(makeKey(KeyKind::Method, atom));
+  }
+  if (requirements.hasSource.value_or(false)) {
+    keys.push_back(makeKey(KeyKind::HasSource));
+  }
+  if (requirements.hasLaunch.value_or(false)) {
+    keys.push_back(makeKey(KeyKind::HasLaunch));
+  }
+  if (requirements.hasInstall.value_or(false)) {
+    keys.push_back(makeKey(KeyKind::HasInstall));
+  }
+  if (requirements.hasDownload.value_or(false)) {
+    keys.push_back(makeKey(KeyKind::HasDownload));
+  }
+
+  std::vector<const Posting *> postings;
+  postings.reserve(keys.size());
+  for (auto key : keys) {
+    auto it = m_postings.find(key);
+    if (it == m_postings.end()) {
+      return {};
+    }
+    postings.push_back(&it->second);
+  }
+
+  std::sort(postings.begin(), postings.end(),
+            [](const Posting *lhs, const Posting *rhs) {
+              return lhs->size() < rhs->size();
+            });
+
+  std::vector<std::shared_ptr<Alternative>> result;
+
+  for (auto id : *postings.front()) {
+    bool found = true;
+    for (auto posting : std::span(postings).subspan(1)) {
+      if (!std::binary_search(posting->begin(), posting->end(), id)) {
+        found = false;
+        break;
+      }
+    }
+
+    if (!found) {
+      continue;
+    }
+
+    // postings only cover positive conditions, negative flags and launch
+    // protocol are checked by the manifest
+    auto &alternative = m_entries[id].alternative;
+    if (alternative->match(requirements)) {
+      result.push_back(alternative);
+    }
+  }
+
+  return result;
+}
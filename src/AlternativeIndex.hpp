@@ -0,0 +1,83 @@
+#pragma once
+
+#include "AlternativeRequirements.hpp"
+#include "Atom.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Alternative;
+
+// Inverted index of alternatives. Every alternative gets a sequence number,
+// posting lists hold sorted sequence numbers per name, capability,
+// contributed alternative/view/method, group membership and flag, so
+// requirement queries intersect the shortest lists instead of scanning every
+// candidate. Results are returned in insertion order.
+class AlternativeIndex {
+public:
+  enum class KeyKind : std::uint8_t {
+    All,
+    Group,
+    Name,
+    Capability,
+    Alternative,
+    View,
+    Method,
+    HasSource,
+    HasLaunch,
+    HasInstall,
+    HasDownload,
+  };
+
+  // indexes alternative by its manifest
+  void add(const std::shared_ptr<Alternative> &alternative);
+  void remove(const std::shared_ptr<Alternative> &alternative);
+
+  // also indexes alternative by its manifest
+  void addToGroup(Atom group, const std::shared_ptr<Alternative> &alternative);
+  void removeFromGroup(Atom group,
+                       const std::shared_ptr<Alternative> &alternative);
+
+  // searches alternatives indexed by add
+  std::vector<std::shared_ptr<Alternative>>
+  find(const InternedRequirements &requirements) const;
+
+  std::vector<std::shared_ptr<Alternative>>
+  findInGroup(Atom group, const InternedRequirements &requirements) const;
+
+  // alternatives indexed under a single name, capability or contribution
+  std::vector<std::shared_ptr<Alternative>> findByKey(KeyKind kind,
+                                                      Atom atom) const;
+
+private:
+  using Key = std::uint64_t;
+  using Posting = std::vector<std::uint32_t>;
+
+  struct Entry {
+    std::shared_ptr<Alternative> alternative;
+    std::vector<Key> keys;
+  };
+
+  static Key makeKey(KeyKind kind, Atom atom = kNullAtom) {
+    return (static_cast<Key>(kind) << 32) | atom;
+  }
+
+  std::uint32_t getOrCreateEntry(const std::shared_ptr<Alternative> &alt);
+  void addKey(std::uint32_t id, Key key);
+  void removeKey(std::uint32_t id, Key key);
+
+  std::vector<std::shared_ptr<Alternative>>
+  query(std::vector<Key> keys, const InternedRequirements &requirements) const;
+
+  // renumbers live entries, dropping the tombstones of removed ones
+  void compact();
+
+  static constexpr std::size_t kMinCompactTombstones = 64;
+
+  std::vector<Entry> m_entries;
+  std::size_t m_tombstones = 0;
+  std::unordered_map<const Alternative *, std::uint32_t> m_ids;
+  std::unordered_map<Key, Posting> m_postings;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Atom.hpp"
+
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -15,6 +17,29 @@ struct AlternativeRequirements {
   std::optional<bool> hasDownload;
 };
 
+// AlternativeRequirements with interned names, built once per query and
+// matched against Manifest atoms
+struct InternedRequirements {
+  Atom name = kNullAtom;
+  AtomSet capabilities;
+  AtomSet alternatives;
+  AtomSet methods;
+  std::optional<bool> hasSource;
+  std::optional<bool> hasLaunch;
+  std::optional<bool> hasInstall;
+  std::optional<bool> hasDownload;
+
+  InternedRequirements() = default;
+  explicit InternedRequirements(const AlternativeRequirements &requirements)
+      : name(internAtom(requirements.name)),
+        capabilities(AtomSet::intern(requirements.capabilities)),
+        alternatives(AtomSet::intern(requirements.alternatives)),
+        methods(AtomSet::intern(requirements.methods)),
+        hasSource(requirements.hasSource), hasLaunch(requirements.hasLaunch),
+        hasInstall(requirements.hasInstall),
+        hasDownload(requirements.hasDownload) {}
+};
+
 static void from_json(const nlohmann::json &json, AlternativeRequirements &object) {
   if (auto it = json.find("name"); it != json.end()) {
     object.name = *it;
@@ -3,11 +3,30 @@
 
 std::vector<std::shared_ptr<Alternative>> AlternativeStorage::findAlternatives(
     std::string_view groupId, const AlternativeRequirements &requirements) {
-  if (auto it = alternativeGroups.find(groupId);
-      it != alternativeGroups.end()) {
-    return it->second->find(requirements);
+  if (!alternativeGroups.contains(groupId)) {
+    return {};
   }
-  return {};
+
+  return index.findInGroup(internAtom(groupId),
+                           InternedRequirements(requirements));
+}
+
+std::vector<std::shared_ptr<Alternative>>
+AlternativeStorage::findAllAlternatives(
+    const AlternativeRequirements &requirements) {
+  return index.find(InternedRequirements(requirements));
+}
+
+std::vector<std::shared_ptr<Alternative>> AlternativeStorage::getSelectedOrFind(
+    std::string_view groupId, AlternativeGroup &group,
+    const AlternativeRequirements &requirements) {
+  InternedRequirements internedRequirements(requirements);
+  if (group.selected != nullptr &&
+      group.selected->match(internedRequirements)) {
+    return {group.selected};
+  }
+
+  return index.findInGroup(internAtom(groupId), internedRequirements);
 }
 
 void AlternativeStorage::selectAlternative(
@@ -25,6 +44,7 @@ bool AlternativeStorage::addAlternativeToGroup(
     return false;
   }
 
+  index.addToGroup(internAtom(groupId), alternative);
   groupIt->second->add(std::move(alternative));
   return true;
 }
@@ -50,13 +70,16 @@ void AlternativeStorage::removeAlternative(
   }
 
   groupIt->second->remove(alternative);
+  index.removeFromGroup(internAtom(groupId), alternative);
 }
 
 std::shared_ptr<Alternative> AlternativeStorage::findAlternative(
     std::string_view name, const AlternativeRequirements &requirements) {
   if (auto it = alternativeGroups.find(name); it != alternativeGroups.end()) {
-    auto result = it->second->getSelectedOrFind(requirements);
-    return result.back();
+    auto result = getSelectedOrFind(name, *it->second, requirements);
+    if (!result.empty()) {
+      return result.back();
+    }
   }
 
   return {};
@@ -66,7 +89,7 @@ std::shared_ptr<Alternative> AlternativeStorage::findAlternativeOrResolve(
     Context &context, std::string_view name,
     const AlternativeRequirements &requirements) {
   if (auto it = alternativeGroups.find(name); it != alternativeGroups.end()) {
-    auto result = it->second->getSelectedOrFind(requirements);
+    auto result = getSelectedOrFind(name, *it->second, requirements);
 
     if (result.size() == 1) {
       return result.front();
@@ -126,10 +149,19 @@ AlternativeStorage::findAlternativeById(std::string_view id) {
   return {};
 }
 
+std::shared_ptr<Alternative>
+AlternativeStorage::findAlternativeById(const ManifestId &id) {
+  if (auto it = allAlternatives.find(id); it != allAlternatives.end()) {
+    return it->second;
+  }
+  return {};
+}
+
 void AlternativeStorage::removeAlternativeFromAll(
     const std::shared_ptr<Alternative> &alternative) {
   for (auto &[groupName, group] : alternativeGroups) {
     group->remove(alternative);
   }
-  allAlternatives.erase(alternative->manifest().id());
+  index.remove(alternative);
+  allAlternatives.erase(alternative->id());
 }
@@ -2,11 +2,13 @@
 
 #include "Alternative.hpp"
 #include "AlternativeGroup.hpp"
+#include "AlternativeIndex.hpp"
 
 #include <map>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 struct AlternativeStorage {
@@ -15,13 +17,20 @@ struct AlternativeStorage {
   std::map<std::string, std::shared_ptr<AlternativeGroup>, std::less<>>
       alternativeGroups;
 
-  std::map<std::string, std::shared_ptr<Alternative>, std::less<>>
+  std::unordered_map<ManifestId, std::shared_ptr<Alternative>,
+                     ManifestId::Hash, std::equal_to<>>
       allAlternatives;
 
+  // covers allAlternatives and group membership
+  AlternativeIndex index;
+
   std::vector<std::shared_ptr<Alternative>>
   findAlternatives(std::string_view groupId,
                    const AlternativeRequirements &requirements);
 
+  std::vector<std::shared_ptr<Alternative>>
+  findAllAlternatives(const AlternativeRequirements &requirements);
+
   void selectAlternative(std::string_view groupId,
                          std::shared_ptr<Alternative> alternative);
 
@@ -39,6 +48,12 @@ struct AlternativeStorage {
   findAlternativeOrResolve(Context &context, std::string_view name,
                            const AlternativeRequirements &requirements = {});
   std::shared_ptr<Alternative> findAlternativeById(std::string_view id);
+  std::shared_ptr<Alternative> findAlternativeById(const ManifestId &id);
   void
   removeAlternativeFromAll(const std::shared_ptr<Alternative> &alternative);
+
+private:
+  std::vector<std::shared_ptr<Alternative>>
+  getSelectedOrFind(std::string_view groupId, AlternativeGroup &group,
+                    const AlternativeRequirements &requirements);
 };
@@ -0,0 +1,896 @@
+#include "Archive.hpp"
+
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <mz.h>
+#include <mz_strm.h>
+#include <mz_strm_os.h>
+#include <mz_zip.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#endif
+
+namespace {
+constexpr std::int32_t kReadChunkSize = 1 << 20;
+
+struct Entry {
+  std::int64_t position;
+  std::filesystem::path path;
+  std::uint64_t size;
+  std::uint32_t attributes;
+};
+
+class ZipReader {
+  void *m_stream = nullptr;
+  void *m_zip = nullptr;
+  bool m_streamOpened = false;
+  bool m_zipOpened = false;
+
+public:
+  ZipReader() = default;
+  ZipReader(const ZipReader &) = delete;
+  ZipReader &operator=(const ZipReader &) = delete;
+
+  ~ZipReader() {
+    if (m_zipOpened) {
+      mz_zip_close(m_zip);
+    }
+    if (m_zip != nullptr) {
+      mz_zip_delete(&m_zip);
+    }
+    if (m_streamOpened) {
+      mz_stream_close(m_stream);
+    }
+    if (m_stream != nullptr) {
+      mz_stream_os_delete(&m_stream);
+    }
+  }
+
+  std::int32_t open(const std::filesystem::path &path) {
+    m_stream = mz_stream_os_create();
+    m_zip = mz_zip_create();
+    if (m_stream == nullptr || m_zip == nullptr) {
+      return MZ_MEM_ERROR;
+    }
+
+    auto pathString = path.u8string();
+    if (auto err =
+            mz_stream_open(m_stream,
+                           reinterpret_cast<const char *>(pathString.c_str()),
+                           MZ_OPEN_MODE_READ);
+        err != MZ_OK) {
+      return err;
+    }
+    m_streamOpened = true;
+
+    if (auto err = mz_zip_open(m_zip, m_stream, MZ_OPEN_MODE_READ);
+        err != MZ_OK) {
+      return err;
+    }
+    m_zipOpened = true;
+    return MZ_OK;
+  }
+
+  void *handle() const { return m_zip; }
+};
+
+struct FileCloser {
+  void operator()(std::FILE *file) const { std::fclose(file); }
+};
+
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+FilePtr openForWrite(const std::filesystem::path &path) {
+#ifdef _WIN32
+  FilePtr file(_wfopen(path.c_str(), L"wb"));
+#else
+  FilePtr file(std::fopen(path.c_str(), "wb"));
+#endif
+
+  if (file != nullptr) {
+    // writes are already done in large chunks
+    std::setvbuf(file.get(), nullptr, _IONBF, 0);
+  }
+  return file;
+}
+
+// Reserves the whole file up front, so the filesystem does not have to grow
+// it with every chunk. Failures are ignored, the writes still extend the file.
+void preallocate(std::FILE *file, std::uint64_t size) {
+  if (size == 0) {
+    return;
+  }
+
+#ifdef _WIN32
+  _chsize_s(_fileno(file), static_cast<__int64>(size));
+#else
+  posix_fallocate(fileno(file), 0, static_cast<off_t>(size));
+#endif
+}
+
+// Rejects absolute entries and entries escaping the destination
+std::optional<std::filesystem::path>
+sanitizeEntryPath(std::string_view name) {
+  auto path = std::filesystem::path(
+                  std::u8string_view(
+                      reinterpret_cast<const char8_t *>(name.data()),
+                      name.size()))
+                  .lexically_normal();
+
+  if (path.empty() || path.has_root_path() || *path.begin() == "..") {
+    return {};
+  }
+  return path;
+}
+
+std::error_code toErrorCode(std::int32_t err) {
+  switch (err) {
+  case MZ_OK:
+    return {};
+  case MZ_MEM_ERROR:
+    return std::make_error_code(std::errc::not_enough_memory);
+  case MZ_OPEN_ERROR:
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  case MZ_WRITE_ERROR:
+    return std::make_error_code(std::errc::io_error);
+  default:
+    return std::make_error_code(std::errc::illegal_byte_sequence);
+  }
+}
+
+class Extractor {
+  const std::filesystem::path &m_archive;
+  const std::filesystem::path &m_destination;
+  const std::vector<Entry> &m_entries;
+  std::uint64_t m_totalBytes = 0;
+
+  std::atomic<std::size_t> m_next{0};
+  std::atomic<std::int32_t> m_error{MZ_OK};
+  std::atomic<std::uint64_t> m_extractedBytes{0};
+  std::atomic<std::uint64_t> m_reportedPercent{0};
+
+  std::mutex m_progressMutex;
+  std::move_only_function<void(const ArchiveProgress &)> m_onProgress;
+
+public:
+  Extractor(const std::filesystem::path &archive,
+            const std::filesystem::path &destination,
+            const std::vector<Entry> &entries,
+            std::move_only_function<void(const ArchiveProgress &)> onProgress)
+      : m_archive(archive), m_destination(destination), m_entries(entries),
+        m_onProgress(std::move(onProgress)) {
+    for (auto &entry : m_entries) {
+      m_totalBytes += entry.size;
+    }
+  }
+
+  std::int32_t run() {
+    if (m_entries.empty()) {
+      return MZ_OK;
+    }
+
+    // the calling thread works as well, so the extraction advances even
+    // when the pool is busy. waiting on a worker that did not start yet
+    // runs it here
+    auto threadCount = std::clamp<std::size_t>(
+        QThreadPool::globalInstance()->maxThreadCount(), 1,
+        m_entries.size());
+
+    std::vector<QFuture<void>> workers;
+    workers.reserve(threadCount - 1);
+    for (std::size_t i = 1; i < threadCount; ++i) {
+      workers.push_back(QtConcurrent::run([this] { work(); }));
+    }
+
+    work();
+    for (auto &worker : workers) {
+      worker.waitForFinished();
+    }
+    return m_error.load();
+  }
+
+private:
+  void fail(std::int32_t err) {
+    std::int32_t expected = MZ_OK;
+    m_error.compare_exchange_strong(expected, err);
+  }
+
+  bool failed() const {
+    return m_error.load(std::memory_order::relaxed) != MZ_OK;
+  }
+
+  void work() {
+    ZipReader reader;
+    if (auto err = reader.open(m_archive); err != MZ_OK) {
+      fail(err);
+      return;
+    }
+
+    std::vector<char> buffer(kReadChunkSize);
+
+    while (!failed()) {
+      auto index = m_next.fetch_add(1, std::memory_order::relaxed);
+      if (index >= m_entries.size()) {
+        break;
+      }
+
+      auto &entry = m_entries[index];
+      if (auto err = extractFile(reader.handle(), entry, buffer);
+          err != MZ_OK) {
+        std::fprintf(stderr, "failed to extract '%s': %d\n",
+                     entry.path.string().c_str(), err);
+        fail(err);
+      }
+    }
+  }
+
+  std::int32_t extractFile(void *zip, const Entry &entry,
+                           std::vector<char> &buffer) {
+    auto target = m_destination / entry.path;
+
+    if (auto err = mz_zip_goto_entry(zip, entry.position); err != MZ_OK) {
+      return err;
+    }
+
+    auto file = openForWrite(target);
+    if (file == nullptr) {
+      return MZ_OPEN_ERROR;
+    }
+    preallocate(file.get(), entry.size);
+
+    if (auto err = mz_zip_entry_read_open(zip, 0, nullptr); err != MZ_OK) {
+      return err;
+    }
+
+    std::int32_t result = MZ_OK;
+    while (!failed()) {
+      auto read = mz_zip_entry_read(zip, buffer.data(),
+                                    static_cast<std::int32_t>(buffer.size()));
+      if (read <= 0) {
+        result = read;
+        break;
+      }
+
+      if (std::fwrite(buffer.data(), 1, read, file.get()) !=
+          static_cast<std::size_t>(read)) {
+        result = MZ_WRITE_ERROR;
+        break;
+      }
+
+      addProgress(read);
+    }
+
+    // the CRC is verified on close
+    if (auto err = mz_zip_entry_close(zip); result == MZ_OK) {
+      result = err;
+    }
+    if (std::fclose(file.release()) != 0 && result == MZ_OK) {
+      result = MZ_WRITE_ERROR;
+    }
+
+    if (result == MZ_OK && entry.attributes != 0) {
+      std::error_code ec;
+      std::filesystem::permissions(
+          target, static_cast<std::filesystem::perms>(entry.attributes & 0777),
+          ec);
+    }
+
+    return result;
+  }
+
+  void addProgress(std::uint64_t bytes) {
+    auto extracted =
+        m_extractedBytes.fetch_add(bytes, std::memory_order::relaxed) + bytes;
+
+    if (!m_onProgress || m_totalBytes == 0) {
+      return;
+    }
+
+    auto percent = extracted * 100 / m_totalBytes;
+    if (percent <= m_reportedPercent.load(std::memory_order::relaxed)) {
+      return;
+    }
+
+    std::lock_guard lock(m_progressMutex);
+    if (percent <= m_reportedPercent.load(std::memory_order::relaxed)) {
+      return;
+    }
+
+    m_reportedPercent.store(percent, std::memory_order::relaxed);
+    m_onProgress({.extractedBytes = extracted, .totalBytes = m_totalBytes});
+  }
+};
+
+// Whether destination / path resolves inside destination without following
+// a link on the way, path is relative to destination
+bool isContained(const std::filesystem::path &destination,
+                 const std::filesystem::path &path) {
+  std::error_code ec;
+  auto current = destination;
+  for (auto &component : path) {
+    current /= component;
+    if (std::filesystem::is_symlink(
+            std::filesystem::symlink_status(current, ec))) {
+      return false;
+    }
+  }
+
+  auto root = std::filesystem::weakly_canonical(destination, ec);
+  if (ec) {
+    return false;
+  }
+  auto resolved = std::filesystem::weakly_canonical(destination / path, ec);
+  if (ec) {
+    return false;
+  }
+
+  auto relative = resolved.lexically_relative(root);
+  return !relative.empty() && *relative.begin() != "..";
+}
+
+// Symlinks are created after all files and hardlinks were written, so that
+// nothing is written through a link. Links pointing outside of the archive,
+// or through another link, are skipped.
+void createSymlink(const std::filesystem::path &destination,
+                   const std::filesystem::path &path,
+                   const std::string &target) {
+  auto resolved = (path.parent_path() / target).lexically_normal();
+  if (std::filesystem::path(target).has_root_path() || resolved.empty() ||
+      *resolved.begin() == ".." ||
+      !isContained(destination, path.parent_path()) ||
+      !isContained(destination, resolved)) {
+    std::fprintf(stderr, "Ignoring symlink '%s' outside of archive\n",
+                 path.string().c_str());
+    return;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_symlink(target, destination / path, ec);
+  if (ec) {
+    std::fprintf(stderr, "failed to create symlink '%s': %s\n",
+                 path.string().c_str(), ec.message().c_str());
+  }
+}
+
+std::int32_t extractSymlinks(void *zip,
+                             const std::filesystem::path &destination,
+                             const std::vector<Entry> &symlinks) {
+  for (auto &entry : symlinks) {
+    if (auto err = mz_zip_goto_entry(zip, entry.position); err != MZ_OK) {
+      return err;
+    }
+    if (auto err = mz_zip_entry_read_open(zip, 0, nullptr); err != MZ_OK) {
+      return err;
+    }
+
+    std::string target(entry.size, '\0');
+    auto read = mz_zip_entry_read(zip, target.data(),
+                                  static_cast<std::int32_t>(target.size()));
+    mz_zip_entry_close(zip);
+
+    if (read < 0) {
+      return read;
+    }
+    target.resize(read);
+
+    createSymlink(destination, entry.path, target);
+  }
+
+  return MZ_OK;
+}
+
+// Extracts a ustar stream as it arrives, with GNU long names and pax path
+// records. Links are created once the whole stream was written.
+class TarExtractor {
+  static constexpr std::size_t kBlockSize = 512;
+
+  // pax and GNU long name records are kept in memory
+  static constexpr std::uint64_t kMaxMetaSize = 1 << 20;
+
+  enum class State { Header, Data, Padding, End };
+  enum class EntryKind { Skip, File, Meta };
+
+  const std::filesystem::path &m_destination;
+  State m_state = State::Header;
+  std::array<char, kBlockSize> m_block;
+  std::size_t m_blockSize = 0;
+  std::uint64_t m_remaining = 0;
+  std::uint64_t m_padding = 0;
+
+  EntryKind m_entryKind = EntryKind::Skip;
+  char m_metaType = 0;
+  std::string m_meta;
+  std::string m_longName;
+  std::string m_longLink;
+  std::optional<std::uint64_t> m_paxSize;
+
+  FilePtr m_file;
+  std::filesystem::path m_filePath;
+  std::uint32_t m_fileMode = 0;
+
+  std::vector<std::pair<std::filesystem::path, std::string>> m_symlinks;
+  std::vector<std::pair<std::filesystem::path, std::filesystem::path>>
+      m_hardlinks;
+
+public:
+  TarExtractor(const std::filesystem::path &destination)
+      : m_destination(destination) {}
+
+  std::error_code write(std::span<const char> data) {
+    while (!data.empty()) {
+      switch (m_state) {
+      case State::End:
+        // trailing zero blocks
+        return {};
+
+      case State::Header: {
+        auto chunk = std::min(data.size(), kBlockSize - m_blockSize);
+        std::memcpy(m_block.data() + m_blockSize, data.data(), chunk);
+        m_blockSize += chunk;
+        data = data.subspan(chunk);
+
+        if (m_blockSize == kBlockSize) {
+          m_blockSize = 0;
+          if (auto ec = processHeader()) {
+            return ec;
+          }
+        }
+        break;
+      }
+
+      case State::Data: {
+        auto chunk = static_cast<std::size_t>(
+            std::min<std::uint64_t>(data.size(), m_remaining));
+        if (auto ec = processData(data.first(chunk))) {
+          return ec;
+        }
+
+        m_remaining -= chunk;
+        data = data.subspan(chunk);
+
+        if (m_remaining == 0) {
+          if (auto ec = finishEntry()) {
+            return ec;
+          }
+        }
+        break;
+      }
+
+      case State::Padding: {
+        auto chunk = static_cast<std::size_t>(
+            std::min<std::uint64_t>(data.size(), m_padding));
+        m_padding -= chunk;
+        data = data.subspan(chunk);
+
+        if (m_padding == 0) {
+          m_state = State::Header;
+        }
+        break;
+      }
+      }
+    }
+
+    return {};
+  }
+
+  std::error_code finish() {
+    if (m_state != State::End &&
+        (m_state != State::Header || m_blockSize != 0)) {
+      return std::make_error_code(std::errc::illegal_byte_sequence);
+    }
+
+    for (auto &[path, target] : m_hardlinks) {
+      if (!isContained(m_destination, path) ||
+          !isContained(m_destination, target)) {
+        std::fprintf(stderr, "Ignoring link '%s' outside of archive\n",
+                     path.string().c_str());
+        continue;
+      }
+
+      std::error_code ec;
+      std::filesystem::create_hard_link(m_destination / target,
+                                        m_destination / path, ec);
+      if (ec) {
+        std::filesystem::copy_file(m_destination / target,
+                                   m_destination / path, ec);
+      }
+      if (ec) {
+        std::fprintf(stderr, "failed to create link '%s': %s\n",
+                     path.string().c_str(), ec.message().c_str());
+      }
+    }
+
+    for (auto &[path, target] : m_symlinks) {
+      createSymlink(m_destination, path, target);
+    }
+
+    return {};
+  }
+
+private:
+  std::string_view field(std::size_t offset, std::size_t size) const {
+    std::string_view result(m_block.data() + offset, size);
+    return result.substr(0, result.find('\0'));
+  }
+
+  // octal, or base-256 for values that do not fit
+  std::optional<std::uint64_t> parseNumber(std::size_t offset,
+                                           std::size_t size) const {
+    std::uint64_t result = 0;
+
+    if (static_cast<unsigned char>(m_block[offset]) & 0x80) {
+      result = m_block[offset] & 0x7f;
+      for (std::size_t i = 1; i < size; ++i) {
+        result = (result << 8) |
+                 static_cast<unsigned char>(m_block[offset + i]);
+      }
+      return result;
+    }
+
+    auto text = field(offset, size);
+    auto begin = text.find_first_not_of(' ');
+    if (begin == std::string_view::npos) {
+      return 0;
+    }
+
+    for (auto c : text.substr(begin)) {
+      if (c == ' ') {
+        break;
+      }
+      if (c < '0' || c > '7') {
+        return {};
+      }
+      result = result * 8 + (c - '0');
+    }
+    return result;
+  }
+
+  bool checksumMatches() const {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < kBlockSize; ++i) {
+      // the checksum field itself is summed as spaces
+      auto inChecksum = i >= 148 && i < 156;
+      sum += inChecksum ? ' ' : static_cast<unsigned char>(m_block[i]);
+    }
+    return parseNumber(148, 8) == sum;
+  }
+
+  std::error_code processHeader() {
+    if (std::all_of(m_block.begin(), m_block.end(),
+                    [](char c) { return c == 0; })) {
+      m_state = State::End;
+      return {};
+    }
+
+    auto size = parseNumber(124, 12);
+    if (!size || !checksumMatches()) {
+      return std::make_error_code(std::errc::illegal_byte_sequence);
+    }
+
+    auto type = m_block[156];
+    auto isMeta = type == 'L' || type == 'K' || type == 'x' || type == 'g';
+
+    if (!isMeta && m_paxSize) {
+      size = std::exchange(m_paxSize, std::nullopt);
+    }
+
+    m_remaining = *size;
+    m_padding = (kBlockSize - m_remaining % kBlockSize) % kBlockSize;
+    m_entryKind = EntryKind::Skip;
+    m_state = State::Data;
+
+    if (isMeta) {
+      if (type != 'g') {
+        if (m_remaining > kMaxMetaSize) {
+          return std::make_error_code(std::errc::file_too_large);
+        }
+
+        m_entryKind = EntryKind::Meta;
+        m_metaType = type;
+        m_meta.clear();
+      }
+    } else {
+      if (auto ec = startEntry(type)) {
+        return ec;
+      }
+    }
+
+    return m_remaining == 0 ? finishEntry() : std::error_code{};
+  }
+
+  std::error_code startEntry(char type) {
+    auto name = std::exchange(m_longName, {});
+    auto link = std::exchange(m_longLink, {});
+
+    if (name.empty()) {
+      name = field(0, 100);
+      auto prefix = field(345, 155);
+      if (field(257, 6).starts_with("ustar") && !prefix.empty()) {
+        name = std::string(prefix) + "/" + name;
+      }
+    }
+    if (link.empty()) {
+      link = field(157, 100);
+    }
+
+    auto path = sanitizeEntryPath(name);
+    if (!path) {
+      std::fprintf(stderr, "Ignoring archive entry '%s' outside of archive\n",
+                   name.c_str());
+      return {};
+    }
+
+    auto target = m_destination / *path;
+    std::error_code ec;
+
+    switch (type) {
+    case '0':
+    case '\0':
+    case '7':
+      std::filesystem::create_directories(target.parent_path(), ec);
+      if (ec) {
+        return ec;
+      }
+
+      m_file = openForWrite(target);
+      if (m_file == nullptr) {
+        return std::make_error_code(std::errc::io_error);
+      }
+      preallocate(m_file.get(), m_remaining);
+
+      m_entryKind = EntryKind::File;
+      m_filePath = std::move(target);
+      m_fileMode = static_cast<std::uint32_t>(parseNumber(100, 8).value_or(0));
+      return {};
+
+    case '5':
+      std::filesystem::create_directories(target, ec);
+      return ec;
+
+    case '2':
+      m_symlinks.emplace_back(std::move(*path), std::move(link));
+      return {};
+
+    case '1':
+      if (auto linkPath = sanitizeEntryPath(link)) {
+        m_hardlinks.emplace_back(std::move(*path), std::move(*linkPath));
+      }
+      return {};
+
+    default:
+      // devices and fifos are not extracted
+      return {};
+    }
+  }
+
+  std::error_code processData(std::span<const char> data) {
+    switch (m_entryKind) {
+    case EntryKind::File:
+      if (std::fwrite(data.data(), 1, data.size(), m_file.get()) !=
+          data.size()) {
+        return std::make_error_code(std::errc::io_error);
+      }
+      break;
+
+    case EntryKind::Meta:
+      m_meta.append(data.data(), data.size());
+      break;
+
+    case EntryKind::Skip:
+      break;
+    }
+
+    return {};
+  }
+
+  std::error_code finishEntry() {
+    m_state = m_padding == 0 ? State::Header : State::Padding;
+
+    if (m_entryKind == EntryKind::File) {
+      if (std::fclose(m_file.release()) != 0) {
+        return std::make_error_code(std::errc::io_error);
+      }
+
+      if (m_fileMode != 0) {
+        std::error_code ec;
+        std::filesystem::permissions(
+            m_filePath, static_cast<std::filesystem::perms>(m_fileMode & 0777),
+            ec);
+      }
+    } else if (m_entryKind == EntryKind::Meta) {
+      processMeta();
+    }
+
+    m_entryKind = EntryKind::Skip;
+    return {};
+  }
+
+  void processMeta() {
+    if (m_metaType == 'L') {
+      m_longName = m_meta.substr(0, m_meta.find('\0'));
+      return;
+    }
+
+    if (m_metaType == 'K') {
+      m_longLink = m_meta.substr(0, m_meta.find('\0'));
+      return;
+    }
+
+    // pax records are "<length> <key>=<value>\n"
+    std::string_view records = m_meta;
+    while (!records.empty()) {
+      auto space = records.find(' ');
+      if (space == std::string_view::npos) {
+        break;
+      }
+
+      std::size_t length = 0;
+      for (auto c : records.substr(0, space)) {
+        length = length * 10 + (c - '0');
+      }
+      if (length <= space + 1 || length > records.size()) {
+        break;
+      }
+
+      auto record = records.substr(space + 1, length - space - 2);
+      records.remove_prefix(length);
+
+      auto eq = record.find('=');
+      if (eq == std::string_view::npos) {
+        continue;
+      }
+
+      auto key = record.substr(0, eq);
+      auto value = record.substr(eq + 1);
+      if (key == "path") {
+        m_longName = value;
+      } else if (key == "linkpath") {
+        m_longLink = value;
+      } else if (key == "size") {
+        std::uint64_t size = 0;
+        for (auto c : value) {
+          size = size * 10 + (c - '0');
+        }
+        m_paxSize = size;
+      }
+    }
+  }
+};
+} // namespace
+
+std::error_code
+extractZipArchive(const std::filesystem::path &archive,
+                  const std::filesystem::path &destination,
+                  std::move_only_function<void(const ArchiveProgress &)>
+                      onProgress) {
+  ZipReader reader;
+  if (auto err = reader.open(archive); err != MZ_OK) {
+    std::fprintf(stderr, "failed to open archive '%s': %d\n",
+                 archive.string().c_str(), err);
+    return toErrorCode(err);
+  }
+
+  auto zip = reader.handle();
+  std::vector<Entry> files;
+  std::vector<Entry> symlinks;
+  std::vector<std::filesystem::path> directories;
+
+  for (auto err = mz_zip_goto_first_entry(zip); err != MZ_END_OF_LIST;
+       err = mz_zip_goto_next_entry(zip)) {
+    if (err != MZ_OK) {
+      return toErrorCode(err);
+    }
+
+    mz_zip_file *info = nullptr;
+    if (auto infoErr = mz_zip_entry_get_info(zip, &info); infoErr != MZ_OK) {
+      return toErrorCode(infoErr);
+    }
+
+    auto path = sanitizeEntryPath(info->filename);
+    if (!path) {
+      std::fprintf(stderr, "Ignoring archive entry '%s' outside of archive\n",
+                   info->filename);
+      continue;
+    }
+
+    if (mz_zip_entry_is_dir(zip) == MZ_OK) {
+      directories.push_back(std::move(*path));
+      continue;
+    }
+
+    std::uint32_t attributes = 0;
+    mz_zip_attrib_convert(MZ_HOST_SYSTEM(info->version_madeby),
+                          info->external_fa, MZ_HOST_SYSTEM_UNIX, &attributes);
+
+    Entry entry{
+        .position = mz_zip_get_entry(zip),
+        .path = std::move(*path),
+        .size = static_cast<std::uint64_t>(info->uncompressed_size),
+        .attributes = attributes,
+    };
+
+    directories.push_back(entry.path.parent_path());
+    if (mz_zip_entry_is_symlink(zip) == MZ_OK) {
+      symlinks.push_back(std::move(entry));
+    } else {
+      files.push_back(std::move(entry));
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(destination, ec);
+  for (auto &directory : directories) {
+    if (ec) {
+      break;
+    }
+    std::filesystem::create_directories(destination / directory, ec);
+  }
+  if (ec) {
+    std::fprintf(stderr, "failed to create directories in '%s': %s\n",
+                 destination.string().c_str(), ec.message().c_str());
+    return ec;
+  }
+
+  // handing out the largest entries first keeps the workers busy until the
+  // end instead of leaving one of them with a big file
+  std::sort(files.begin(), files.end(), [](const Entry &lhs, const Entry &rhs) {
+    return lhs.size > rhs.size;
+  });
+
+  Extractor extractor(archive, destination, files, std::move(onProgress));
+  auto err = extractor.run();
+
+  if (err == MZ_OK) {
+    err = extractSymlinks(zip, destination, symlinks);
+  }
+
+  return toErrorCode(err);
+}
+
+std::error_code
+extractTarArchive(std::move_only_function<std::size_t(std::span<char>)> read,
+                  Compression compression,
+                  const std::filesystem::path &destination) {
+  std::error_code ec;
+  std::filesystem::create_directories(destination, ec);
+  if (ec) {
+    return ec;
+  }
+
+  TarExtractor extractor(destination);
+  auto decompressor = Decompressor::create(
+      compression,
+      [&](std::span<const char> data) { return extractor.write(data); });
+
+  if (decompressor == nullptr) {
+    return std::make_error_code(std::errc::not_supported);
+  }
+
+  std::vector<char> buffer(kReadChunkSize);
+  while (auto size = read(buffer)) {
+    if (auto ec = decompressor->write(std::span(buffer).first(size))) {
+      return ec;
+    }
+  }
+
+  if (auto ec = decompressor->finish()) {
+    return ec;
+  }
+
+  return extractor.finish();
+}
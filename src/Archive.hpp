@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Decompressor.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <system_error>
+
+struct ArchiveProgress {
+  std::uint64_t extractedBytes = 0;
+  std::uint64_t totalBytes = 0;
+};
+
+// Extracts the zip archive into destination, which is created if needed.
+// Files are inflated by a pool of worker threads, each with its own handle of
+// the archive, largest entries first. onProgress is called from the workers,
+// calls are serialized and happen at most once per percent.
+std::error_code
+extractZipArchive(const std::filesystem::path &archive,
+                  const std::filesystem::path &destination,
+                  std::move_only_function<void(const ArchiveProgress &)>
+                      onProgress = nullptr);
+
+// Extracts a tar stream compressed with compression. read is called with a
+// buffer until it returns 0, so the source can be a download that is still in
+// progress.
+std::error_code
+extractTarArchive(std::move_only_function<std::size_t(std::span<char>)> read,
+                  Compression compression,
+                  const std::filesystem::path &destination);
@@ -0,0 +1,59 @@
+#include "Atom.hpp"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+struct AtomTable {
+  std::shared_mutex mutex;
+  std::deque<std::string> names{std::string()};
+  std::unordered_map<std::string_view, Atom> atoms{{names.front(), kNullAtom}};
+
+  static AtomTable &instance() {
+    static AtomTable table;
+    return table;
+  }
+};
+} // namespace
+
+Atom internAtom(std::string_view name) {
+  auto &table = AtomTable::instance();
+
+  {
+    std::shared_lock lock(table.mutex);
+    if (auto it = table.atoms.find(name); it != table.atoms.end()) {
+      return it->second;
+    }
+  }
+
+  std::lock_guard lock(table.mutex);
+  if (auto it = table.atoms.find(name); it != table.atoms.end()) {
+    return it->second;
+  }
+
+  auto atom = static_cast<Atom>(table.names.size());
+  auto &storage = table.names.emplace_back(name);
+  table.atoms.emplace(storage, atom);
+  return atom;
+}
+
+Atom findAtom(std::string_view name) {
+  auto &table = AtomTable::instance();
+  std::shared_lock lock(table.mutex);
+  if (auto it = table.atoms.find(name); it != table.atoms.end()) {
+    return it->second;
+  }
+  return kNullAtom;
+}
+
+std::string_view getAtomName(Atom atom) {
+  auto &table = AtomTable::instance();
+  std::shared_lock lock(table.mutex);
+  if (atom >= table.names.size()) {
+    return {};
+  }
+  return table.names[atom];
+}
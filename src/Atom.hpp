@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Interned string. Atoms are process wide and never released, two atoms are
+// equal if and only if their names are equal.
+using Atom = std::uint32_t;
+
+// Atom of the empty string
+inline constexpr Atom kNullAtom = 0;
+
+Atom internAtom(std::string_view name);
+// kNullAtom if name was never interned
+Atom findAtom(std::string_view name);
+std::string_view getAtomName(Atom atom);
+
+// Sorted set of atoms with a 64 bit summary of its content, so most failing
+// subset checks are decided by a single AND
+class AtomSet {
+  std::vector<Atom> m_atoms;
+  std::uint64_t m_mask = 0;
+
+  static std::uint64_t maskOf(Atom atom) {
+    return std::uint64_t(1) << (atom % 64);
+  }
+
+public:
+  AtomSet() = default;
+
+  template <typename Range> static AtomSet intern(const Range &names) {
+    AtomSet result;
+    result.m_atoms.reserve(std::size(names));
+    for (auto &name : names) {
+      auto atom = internAtom(name);
+      result.m_atoms.push_back(atom);
+      result.m_mask |= maskOf(atom);
+    }
+    std::sort(result.m_atoms.begin(), result.m_atoms.end());
+    result.m_atoms.erase(
+        std::unique(result.m_atoms.begin(), result.m_atoms.end()),
+        result.m_atoms.end());
+    return result;
+  }
+
+  void insert(Atom atom) {
+    auto it = std::lower_bound(m_atoms.begin(), m_atoms.end(), atom);
+    if (it == m_atoms.end() || *it != atom) {
+      m_atoms.insert(it, atom);
+      m_mask |= maskOf(atom);
+    }
+  }
+
+  bool contains(Atom atom) const {
+    return (m_mask & maskOf(atom)) != 0 &&
+           std::binary_search(m_atoms.begin(), m_atoms.end(), atom);
+  }
+
+  bool includes(const AtomSet &other) const {
+    if ((other.m_mask & ~m_mask) != 0 || other.size() > size()) {
+      return false;
+    }
+
+    return std::includes(m_atoms.begin(), m_atoms.end(),
+                         other.m_atoms.begin(), other.m_atoms.end());
+  }
+
+  bool empty() const { return m_atoms.empty(); }
+  std::size_t size() const { return m_atoms.size(); }
+  auto begin() const { return m_atoms.begin(); }
+  auto end() const { return m_atoms.end(); }
+
+  bool operator==(const AtomSet &) const = default;
+};
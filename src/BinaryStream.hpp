@@ -0,0 +1,94 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Little endian binary encoding shared by the package and repository indexes.
+// Strings are u32 length followed by bytes, lists are u32 count followed by
+// elements, optionals are u8 flag followed by value.
+
+template <typename T> constexpr T toLittleEndian(T value) {
+  if constexpr (std::is_integral_v<T> &&
+                std::endian::native == std::endian::big) {
+    return std::byteswap(value);
+  } else {
+    return value;
+  }
+}
+
+struct BinaryWriter {
+  std::string &out;
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void write(const T &value) {
+    auto encoded = toLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&encoded), sizeof(T));
+  }
+
+  void write(std::string_view string) {
+    write(static_cast<std::uint32_t>(string.size()));
+    out.append(string);
+  }
+
+  template <typename Range> void writeList(const Range &range) {
+    write(static_cast<std::uint32_t>(std::size(range)));
+    for (auto &item : range) {
+      write(std::string_view(item));
+    }
+  }
+};
+
+struct BinaryReader {
+  std::span<const char> data;
+
+  void check(std::size_t size) const {
+    if (data.size() < size) {
+      throw std::runtime_error("unexpected end of data");
+    }
+  }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  T read() {
+    check(sizeof(T));
+    T result;
+    std::memcpy(&result, data.data(), sizeof(T));
+    data = data.subspan(sizeof(T));
+    return toLittleEndian(result);
+  }
+
+  std::string readString() {
+    auto size = read<std::uint32_t>();
+    check(size);
+    std::string result(data.data(), size);
+    data = data.subspan(size);
+    return result;
+  }
+
+  template <typename Container> Container readList() {
+    Container result;
+    auto count = read<std::uint32_t>();
+    for (std::uint32_t i = 0; i < count; ++i) {
+      result.insert(result.end(), readString());
+    }
+    return result;
+  }
+
+  // consumes magic if data starts with it
+  bool readMagic(std::span<const char, 4> magic) {
+    check(magic.size());
+    if (std::memcmp(data.data(), magic.data(), magic.size()) != 0) {
+      return false;
+    }
+    data = data.subspan(magic.size());
+    return true;
+  }
+};
@@ -0,0 +1,101 @@
+#include "ByteChannel.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+std::size_t ByteChannel::space() const {
+  std::lock_guard lock(m_mutex);
+  return m_cancelled ? 0 : m_buffer.size() - m_size;
+}
+
+std::size_t ByteChannel::write(std::span<const char> bytes) {
+  std::size_t written = 0;
+
+  {
+    std::lock_guard lock(m_mutex);
+    if (m_closed || m_cancelled) {
+      return 0;
+    }
+
+    while (written < bytes.size() && m_size < m_buffer.size()) {
+      auto tail = (m_head + m_size) % m_buffer.size();
+      auto chunk = std::min({bytes.size() - written, m_buffer.size() - m_size,
+                             m_buffer.size() - tail});
+      std::memcpy(m_buffer.data() + tail, bytes.data() + written, chunk);
+      m_size += chunk;
+      written += chunk;
+    }
+
+    if (m_size == m_buffer.size()) {
+      m_stalled = true;
+    }
+  }
+
+  m_cv.notify_one();
+  return written;
+}
+
+void ByteChannel::close(bool failed) {
+  {
+    std::lock_guard lock(m_mutex);
+    m_closed = true;
+    m_failed = failed;
+  }
+  m_cv.notify_one();
+}
+
+bool ByteChannel::cancelled() const {
+  std::lock_guard lock(m_mutex);
+  return m_cancelled;
+}
+
+std::size_t ByteChannel::read(std::span<char> buffer) {
+  std::size_t result = 0;
+  bool resume = false;
+
+  {
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_size != 0 || m_closed || m_cancelled; });
+
+    if (m_cancelled) {
+      return 0;
+    }
+
+    while (result < buffer.size() && m_size != 0) {
+      auto chunk = std::min({buffer.size() - result, m_size,
+                             m_buffer.size() - m_head});
+      std::memcpy(buffer.data() + result, m_buffer.data() + m_head, chunk);
+      m_head = (m_head + chunk) % m_buffer.size();
+      m_size -= chunk;
+      result += chunk;
+    }
+
+    if (m_stalled && m_size <= m_buffer.size() / 2) {
+      m_stalled = false;
+      resume = !m_closed;
+    }
+  }
+
+  if (resume && m_onSpace) {
+    m_onSpace();
+  }
+
+  return result;
+}
+
+bool ByteChannel::failed() const {
+  std::lock_guard lock(m_mutex);
+  return m_failed;
+}
+
+void ByteChannel::cancel() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_cancelled = true;
+  }
+
+  // wake up the producer so it can abort
+  if (m_onSpace) {
+    m_onSpace();
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Bounded byte queue between a producer that must not block (a network reply
+// on the UI thread) and a single consumer thread. The producer writes at most
+// space() bytes and stops; once the consumer drained half of the buffer it
+// calls the onSpace callback so the producer can continue.
+class ByteChannel {
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::vector<char> m_buffer;
+  std::size_t m_head = 0;
+  std::size_t m_size = 0;
+  bool m_closed = false;
+  bool m_failed = false;
+  bool m_cancelled = false;
+  bool m_stalled = false;
+  std::move_only_function<void()> m_onSpace;
+
+public:
+  explicit ByteChannel(std::size_t capacity) : m_buffer(capacity) {}
+
+  std::size_t capacity() const { return m_buffer.size(); }
+
+  // must be set before the consumer starts reading
+  void setOnSpace(std::move_only_function<void()> onSpace) {
+    m_onSpace = std::move(onSpace);
+  }
+
+  // producer side
+  std::size_t space() const;
+  std::size_t write(std::span<const char> bytes);
+  void close(bool failed = false);
+  bool cancelled() const;
+
+  // consumer side, blocks until data is available. Returns 0 once the channel
+  // was closed and drained
+  std::size_t read(std::span<char> buffer);
+  bool failed() const;
+  void cancel();
+};
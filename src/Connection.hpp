@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+class [[nodiscard]] Connection {
+  std::move_only_function<void()> m_destroy;
+
+public:
+  Connection() = default;
+  Connection(std::move_only_function<void()> destroy)
+      : m_destroy(std::move(destroy)) {}
+  ~Connection() { destroy(); }
+  Connection(Connection &&) = default;
+  Connection &operator=(Connection &&) = default;
+
+  void destroy() {
+    if (auto fn = std::exchange(m_destroy, nullptr)) {
+      fn();
+    }
+  }
+};
+
+using Connections = std::vector<Connection>;
@@ -0,0 +1,96 @@
+#include "ContentHash.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static constexpr std::size_t kFileChunkSize = 1024 * 1024;
+
+std::unique_ptr<ContentHash> ContentHash::create(std::string_view spec) {
+  auto separator = spec.find(':');
+  if (separator == std::string_view::npos) {
+    std::fprintf(stderr, "invalid hash '%.*s'\n",
+                 static_cast<int>(spec.size()), spec.data());
+    return nullptr;
+  }
+
+  auto name = spec.substr(0, separator);
+  auto digest =
+      QByteArray::fromStdString(std::string(spec.substr(separator + 1)));
+
+  QCryptographicHash::Algorithm algorithm;
+  if (name == "sha256") {
+    algorithm = QCryptographicHash::Sha256;
+  } else if (name == "sha512") {
+    algorithm = QCryptographicHash::Sha512;
+  } else {
+    std::fprintf(stderr, "unsupported hash algorithm '%.*s'\n",
+                 static_cast<int>(name.size()), name.data());
+    return nullptr;
+  }
+
+  auto expected = QByteArray::fromHex(digest);
+  if (expected.size() != QCryptographicHash::hashLength(algorithm) ||
+      expected.toHex() != digest.toLower()) {
+    std::fprintf(stderr, "invalid hash '%.*s'\n",
+                 static_cast<int>(spec.size()), spec.data());
+    return nullptr;
+  }
+
+  return std::make_unique<ContentHash>(algorithm, std::move(expected));
+}
+
+std::error_code ContentHash::copyFile(const std::filesystem::path &source,
+                                      const std::filesystem::path &target,
+                                      std::string_view spec) {
+  std::unique_ptr<ContentHash> hash;
+  if (!spec.empty()) {
+    hash = create(spec);
+    if (hash == nullptr) {
+      return std::make_error_code(std::errc::invalid_argument);
+    }
+  }
+
+  std::ifstream input(source, std::ios::binary);
+  if (!input) {
+    return std::make_error_code(std::errc::no_such_file_or_directory);
+  }
+
+  std::ofstream output(target, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    return std::make_error_code(std::errc::io_error);
+  }
+
+  std::vector<char> buffer(kFileChunkSize);
+  while (input) {
+    input.read(buffer.data(), buffer.size());
+    auto chunk =
+        std::span(buffer.data(), static_cast<std::size_t>(input.gcount()));
+    if (hash != nullptr) {
+      hash->update(chunk);
+    }
+    output.write(chunk.data(), chunk.size());
+  }
+
+  output.close();
+
+  std::error_code ec;
+  if (input.bad() || !output) {
+    ec = std::make_error_code(std::errc::io_error);
+  } else if (hash != nullptr && !hash->verify()) {
+    ec = makeHashMismatchError();
+  }
+
+  if (ec) {
+    std::error_code removeError;
+    std::filesystem::remove(target, removeError);
+  }
+  return ec;
+}
+
+void ContentHash::update(std::span<const char> bytes) {
+  m_hash.addData(QByteArrayView(bytes.data(), bytes.size()));
+}
+
+bool ContentHash::verify() const { return m_hash.result() == m_expected; }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+// Checks the hash field of downloads and installs, "<algorithm>:<hex digest>"
+// with sha256 or sha512. It is fed with the bytes while they stream through
+// the downloader or extractor, so checking needs no pass of its own.
+class ContentHash {
+public:
+  ContentHash(QCryptographicHash::Algorithm algorithm, QByteArray expected)
+      : m_hash(algorithm), m_expected(std::move(expected)) {}
+
+  // returns nullptr if spec is malformed or names an unsupported algorithm
+  static std::unique_ptr<ContentHash> create(std::string_view spec);
+
+  // copies a local archive and hashes the bytes on the way, target is removed
+  // if they do not match. an empty spec copies without checking
+  static std::error_code copyFile(const std::filesystem::path &source,
+                                  const std::filesystem::path &target,
+                                  std::string_view spec);
+
+  void update(std::span<const char> bytes);
+  void reset() { m_hash.reset(); }
+
+  // compares the bytes passed to update so far
+  bool verify() const;
+
+private:
+  QCryptographicHash m_hash;
+  QByteArray m_expected;
+};
+
+// reported when the content does not match its hash
+inline std::error_code makeHashMismatchError() {
+  return std::make_error_code(std::errc::bad_message);
+}
@@ -1,7 +1,20 @@
 #include "Context.hpp"
+#include "Archive.hpp"
+#include "ByteChannel.hpp"
+#include "ContentHash.hpp"
+#include "ManifestStream.hpp"
+#include "NetworkScheduler.hpp"
+#include "RepositoryIndex.hpp"
+#include <QCoreApplication>
+#include <QPromise>
+#include <QTimer>
+#include <QtConcurrent>
+#include <array>
+#include <atomic>
 #include <fstream>
 #include <iterator>
 #include <mutex>
+#include <optional>
 
 inline std::pair<std::string_view, std::string_view>
 splitOnce(std::string_view string, std::string_view separator) {
@@ -32,26 +45,27 @@ Context::Context() {
 }
 
 void Context::addAlternative(std::shared_ptr<Alternative> alternative) {
-  auto altId = alternative->manifest().id();
-  if (auto [it, inserted] = allAlternatives.try_emplace(altId, alternative);
+  if (auto [it, inserted] =
+          allAlternatives.try_emplace(alternative->id(), alternative);
       !inserted) {
     // FIXME: merge alternatives
   }
 
+  index.add(alternative);
+  dependencyResolver.onAdded(*alternative);
+
   for (auto &groupId : alternative->manifest().contributes.alternatives) {
-    auto groupIt = alternativeGroups.find(groupId);
-    if (groupIt == alternativeGroups.end()) {
+    if (!addAlternativeToGroup(groupId, alternative)) {
       std::fprintf(
           stderr,
           "Ignoring adding alternative '%s' to non existing group '%s'\n",
-          alternative->manifest().id().c_str(), groupId.c_str());
-      continue;
+          alternative->id().str().c_str(), groupId.c_str());
     }
-
-    groupIt->second->add(alternative);
   }
 
   for (auto &ext : alternative->manifest().contributes.methods) {
+    // every method that can be routed has an id
+    internMethod(ext);
     methods.addAlternativeGroup(ext, "");
     methods.addAlternativeToGroup(ext, alternative);
   }
@@ -60,6 +74,17 @@ void Context::addAlternative(std::shared_ptr<Alternative> alternative) {
     views.addAlternativeGroup(ext, "");
     views.addAlternativeToGroup(ext, alternative);
   }
+
+  ++methodsGeneration;
+}
+
+void Context::removeAlternativeFromAll(
+    const std::shared_ptr<Alternative> &alternative) {
+  AlternativeStorage::removeAlternativeFromAll(alternative);
+  methods.removeAlternativeFromAll(alternative);
+  views.removeAlternativeFromAll(alternative);
+  dependencyResolver.onRemoved(*alternative);
+  ++methodsGeneration;
 }
 
 void Context::selectAlternative(std::string_view kind, std::string_view groupId, std::shared_ptr<Alternative> alternative) {
@@ -73,6 +98,7 @@ void Context::selectAlternative(std::string_view kind, std::string_view groupId,
   }
   if (kind == methods.kind) {
     methods.selectAlternative(groupId, std::move(alternative));
+    ++methodsGeneration;
     return;
   }
 }
@@ -122,73 +148,289 @@ std::error_code Context::hideView(std::string_view name) {
 
 void Context::sendNotification(std::string_view name,
                                const NotificationArgs &args) {
-  auto handlersIt = notificationHandlers.find(name);
-  if (handlersIt == notificationHandlers.end()) {
-    return;
+  notifications.publish(name, args);
+}
+
+NotificationArgs Context::takePackageChanges() {
+  if (pendingPackageAdds.empty() && pendingPackageRemoves.empty()) {
+    return nullptr;
   }
 
-  for (auto &handler : handlersIt->second) {
-    handler(args);
+  // receivers must apply removals first, a source that was reloaded removes
+  // and adds the same ids within one batch
+  return {
+      {"add", std::exchange(pendingPackageAdds, {})},
+      {"remove", std::exchange(pendingPackageRemoves, {})},
+  };
+}
+
+void Context::sendPackageChanges(const NotificationArgs &changes) {
+  if (!changes.is_null()) {
+    sendNotification("packages/change", changes);
   }
 }
 
 Connection Context::createNotificationHandler(
     std::string name,
-    std::move_only_function<void(const NotificationArgs &)> handler) {
-  auto &container = notificationHandlers[std::move(name)];
-  container.push_back(std::move(handler));
-  auto it = std::prev(container.end());
+    std::move_only_function<void(const NotificationArgs &)> handler,
+    NotificationExecutor executor) {
+  return notifications.subscribe(std::move(name), std::move(handler),
+                                 executor);
+}
+
+static bool isEmpty(const AlternativeRequirements &requirements) {
+  return requirements.name.empty() && requirements.capabilities.empty() &&
+         requirements.alternatives.empty() && requirements.methods.empty() &&
+         !requirements.hasSource && !requirements.hasLaunch &&
+         !requirements.hasInstall && !requirements.hasDownload;
+}
+
+std::shared_ptr<Alternative>
+Context::findMethodAlternative(MethodId method,
+                               const AlternativeRequirements &requirements) {
+  if (method == kInvalidMethodId) {
+    return {};
+  }
+
+  auto name = getMethodName(method);
+  if (!isEmpty(requirements)) {
+    return methods.findAlternative(name, requirements);
+  }
+
+  if (method >= resolvedMethods.size()) {
+    resolvedMethods.resize(method + 1);
+  }
 
-  return {[it = std::move(it), &container] { container.erase(it); }};
+  // the selection of a group can change without going through
+  // selectAlternative, so it is compared as well
+  auto &resolved = resolvedMethods[method];
+  if (resolved.generation == methodsGeneration && resolved.group != nullptr &&
+      resolved.group->selected.get() == resolved.selected) {
+    return resolved.alternative;
+  }
+
+  auto it = methods.alternativeGroups.find(name);
+  if (it == methods.alternativeGroups.end()) {
+    resolved = {.generation = methodsGeneration};
+    return {};
+  }
+
+  resolved = {
+      .alternative = methods.findAlternative(name),
+      .group = it->second,
+      .selected = it->second->selected.get(),
+      .generation = methodsGeneration,
+  };
+  return resolved.alternative;
 }
 
 void Context::callMethod(
     std::string_view name, const AlternativeRequirements &requirements,
     const MethodCallArgs &args,
     std::move_only_function<void(const MethodCallResult &)> responseHandler) {
-  if (auto alternative = methods.findAlternative(name, requirements)) {
-    alternative->callMethod(*this, name, args, std::move(responseHandler));
+  // names that were never interned have no group to route to
+  auto method = findMethod(name);
+  if (auto alternative = findMethodAlternative(method, requirements)) {
+    alternative->callMethodById(*this, method, args,
+                                std::move(responseHandler));
   } else {
     responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
   }
 }
 
-void Context::addPackage(const Url &source, const Url &path,
-                         Manifest &&manifest) {
-  if (findAlternativeById(manifest.id())) {
-    // TODO: merge manifests
-    return;
+namespace {
+// A method call that is resolved once, by its response, its timeout or its
+// cancellation, whichever comes first
+struct PendingMethodCall {
+  QPromise<MethodCallResult> promise;
+  std::atomic<bool> finished = false;
+  // stops the work of the alternative when the call ends without a response
+  std::stop_source stopSource;
+  std::optional<std::stop_callback<std::function<void()>>> onCallerStop;
+
+  // an alternative that dropped its response handler without calling it
+  // must not leave the future pending forever
+  ~PendingMethodCall() { finish({{"error", elp::ErrorCode::Cancelled}}); }
+
+  void finish(MethodCallResult result) {
+    if (finished.exchange(true)) {
+      return;
+    }
+
+    promise.addResult(std::move(result));
+    promise.finish();
   }
 
-  for (auto ext : manifest.contributes.packages) {
-    if (ext.install) {
-      auto extPath = Url::makeFromRelative(path, ext.install->path);
-      if (!ext.icon.empty()) {
-        ext.icon = Url::makeFromRelative(path, ext.icon).toString();
-      }
-      addPackage(path, std::move(extPath), std::move(ext));
+  void abandon(elp::ErrorCode error) {
+    finish({{"error", error}});
+    stopSource.request_stop();
+  }
+};
+} // namespace
+
+QFuture<MethodCallResult>
+Context::callMethodAsync(std::string name, AlternativeRequirements requirements,
+                         MethodCallArgs args, MethodCallOptions options) {
+  return dispatchMethodCall(findMethodAlternative(findMethod(name),
+                                                 requirements),
+                            std::move(name), std::move(args),
+                            std::move(options));
+}
+
+QFuture<MethodCallResult> Context::showViewAsync(std::string name,
+                                                 MethodCallArgs args,
+                                                 MethodCallOptions options) {
+  auto alt = views.findAlternativeOrResolve(*this, name, {});
+  if (alt != nullptr) {
+    if (auto ec = activate(alt); ec && ec != std::errc::already_connected) {
+      alt = nullptr;
     }
   }
 
+  return dispatchMethodCall(std::move(alt), "view/show",
+                            {{"id", name}, {"params", std::move(args)}},
+                            std::move(options));
+}
+
+QFuture<MethodCallResult>
+Context::dispatchMethodCall(std::shared_ptr<Alternative> alternative,
+                            std::string name, MethodCallArgs args,
+                            MethodCallOptions options) {
+  auto call = std::make_shared<PendingMethodCall>();
+  call->promise.start();
+  auto future = call->promise.future();
+
+  if (alternative == nullptr) {
+    call->finish({{"error", elp::ErrorCode::MethodNotFound}});
+    return future;
+  }
+
+  if (options.stopToken.stop_possible()) {
+    // the callback is unregistered before call is destroyed
+    call->onCallerStop.emplace(
+        options.stopToken,
+        [call = call.get()] { call->abandon(elp::ErrorCode::Cancelled); });
+  }
+
+  if (options.timeout.count() > 0) {
+    // the timer keeps the call alive, a response handler that is dropped
+    // still resolves it with ErrorCode::Timeout
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [call, timeout = options.timeout] {
+          QTimer::singleShot(
+              timeout, QCoreApplication::instance(),
+              [call] { call->abandon(elp::ErrorCode::Timeout); });
+        });
+  }
+
+  auto run = [this, call, alternative = std::move(alternative),
+              name = std::move(name), args = std::move(args)] {
+    auto stopToken = call->stopSource.get_token();
+    if (stopToken.stop_requested()) {
+      // nobody waits for the result anymore
+      return;
+    }
+
+    alternative->callMethodAsync(
+        *this, name, args, std::move(stopToken),
+        [call](MethodCallResult result) { call->finish(std::move(result)); });
+  };
+
+  switch (options.executor) {
+  case MethodExecutor::Caller:
+    run();
+    break;
+  case MethodExecutor::Worker:
+    QtConcurrent::run(std::move(run));
+    break;
+  case MethodExecutor::Ui:
+    QMetaObject::invokeMethod(QCoreApplication::instance(), std::move(run),
+                              Qt::QueuedConnection);
+    break;
+  }
+
+  return future;
+}
+
+void Context::resolvePackage(const Url &source, const Url &path,
+                             Manifest &&manifest,
+                             std::vector<Manifest> &result) {
+  for (auto &ext : manifest.contributes.packages) {
+    resolveContributedPackage(path, std::move(ext), result);
+  }
+
+  // nested packages were flattened into result
+  manifest.contributes.packages.clear();
   manifest.source = source.toString();
   manifest.path = path.toString();
+  result.push_back(std::move(manifest));
+}
+
+void Context::resolveContributedPackage(const Url &path, Manifest &&manifest,
+                                        std::vector<Manifest> &result) {
+  if (!manifest.install) {
+    return;
+  }
+
+  auto extPath = Url::makeFromRelative(path, manifest.install->path);
+  if (!manifest.icon.empty()) {
+    manifest.icon = Url::makeFromRelative(path, manifest.icon).toString();
+  }
+  resolvePackage(path, extPath, std::move(manifest), result);
+}
+
+void Context::addResolvedPackage(Manifest manifest) {
+  if (manifest.cachedId.empty()) {
+    manifest.precompute();
+  }
+
+  if (findAlternativeById(manifest.cachedId)) {
+    // TODO: merge manifests
+    return;
+  }
 
   auto ui = manifest.ui;
-  auto id = manifest.id();
+  auto path = Url(manifest.path);
+  pendingPackageAdds.push_back(manifest.cachedId.str());
   auto alt = std::make_shared<Alternative>(std::move(manifest));
+  if (!ui.empty()) {
+    alt->setUiSource(&uiSchemaCache, Url::makeFromRelative(path, ui));
+  }
   addAlternative(alt);
+}
 
-  sendNotification("packages/change", {
-                                          {"add", nlohmann::json::array({id})},
-                                      });
+PackageIndex::Source &Context::resetPackageSource(std::string_view url) {
+  auto it = packageIndex.sources.find(url);
+  if (it == packageIndex.sources.end()) {
+    it = packageIndex.sources.emplace(std::string(url), PackageIndex::Source{})
+             .first;
+  } else {
+    for (auto &package : it->second.packages) {
+      if (auto alt = findAlternativeById(package.cachedId)) {
+        removeAlternativeFromAll(alt);
+        pendingPackageRemoves.push_back(package.cachedId.str());
+      }
+    }
 
-  if (!ui.empty()) {
-    Url::makeFromRelative(path, ui).asyncGet().then([=](QByteArray bytes) {
-      IdToSchemaMap uiIdMap;
-      auto uiSchemaNode = parseUiFile(uiIdMap, bytes);
-      alt->setUiSchema(std::move(uiSchemaNode), std::move(uiIdMap));
-    });
+    it->second = {};
+  }
+
+  packageIndexDirty = true;
+  return it->second;
+}
+
+void Context::addSourcePackage(std::string_view url, Manifest manifest) {
+  auto it = packageIndex.sources.find(url);
+  if (it == packageIndex.sources.end()) {
+    it = packageIndex.sources.emplace(std::string(url), PackageIndex::Source{})
+             .first;
   }
+
+  manifest.precompute();
+  addResolvedPackage(manifest);
+  it->second.packages.push_back(std::move(manifest));
+  packageIndexDirty = true;
 }
 
 std::error_code Context::activate(std::string_view id) {
@@ -246,12 +488,29 @@ bool Context::isActive(const std::shared_ptr<Alternative> &alt) {
 }
 
 void Context::loadSettings() {
-  if (std::ifstream f{configPath / "settings.json"}) {
-    try {
-      f >> settings;
-    } catch (...) {
-    }
-  }
+  settings = settingsJournal.open(configPath / "settings.json");
+  ++settingsGeneration;
+  layeredSettings.clear();
+
+  // applied again when the settings change while running
+  settingsObservers.push_back(
+      settingsHandle("network/max-connections", 16).bind([](int count) {
+        NetworkScheduler::instance().setMaxConnections(count);
+      }));
+  settingsObservers.push_back(
+      settingsHandle("network/max-connections-per-host", 4)
+          .bind([](int count) {
+            NetworkScheduler::instance().setMaxConnectionsPerHost(count);
+          }));
+  // bytes per second, 0 is unlimited
+  settingsObservers.push_back(
+      settingsHandle<std::uint64_t>("network/bandwidth-limit", 0)
+          .bind([](std::uint64_t limit) {
+            NetworkScheduler::instance().setBandwidthLimit(limit);
+          }));
+
+  uiSchemaCache.setCacheDirectory(dataPath / "ui-cache");
+  loadPackageIndex();
 
   auto &packages = getSettings("installed-packages", Settings::array());
   for (auto &package : packages.get<std::set<std::string>>()) {
@@ -260,8 +519,60 @@ void Context::loadSettings() {
   }
 }
 void Context::saveSettings() {
-  if (std::ofstream f{configPath / "settings.json"}) {
-    f << settings;
+  // also writes changes made without a commit
+  settingsJournal.reset(settings);
+
+  savePackageIndex();
+}
+
+void Context::loadPackageIndex() {
+  PackageIndex index;
+  if (!index.load(dataPath / "packages.idx")) {
+    return;
+  }
+
+  std::set<std::string> knownSources;
+  for (auto &source : getSettings("package-sources", Settings::array())) {
+    knownSources.insert(Url(source.get<std::string>()).toString());
+  }
+  for (auto &source : getSettings("installed-packages", Settings::array())) {
+    knownSources.insert(Url(source.get<std::string>()).toString());
+  }
+
+  NotificationArgs changes;
+  {
+    std::lock_guard lock(mutex);
+    for (auto &[url, source] : index.sources) {
+      if (!knownSources.contains(url)) {
+        // source was removed, drop it from the index on next save
+        packageIndexDirty = true;
+        continue;
+      }
+
+      for (auto &package : source.packages) {
+        package.precompute();
+        addResolvedPackage(package);
+      }
+
+      packageIndex.sources.emplace(url, std::move(source));
+    }
+
+    changes = takePackageChanges();
+  }
+
+  sendPackageChanges(changes);
+}
+
+void Context::savePackageIndex() {
+  std::lock_guard lock(mutex);
+  if (!packageIndexDirty) {
+    return;
+  }
+
+  if (packageIndex.save(dataPath / "packages.idx")) {
+    packageIndexDirty = false;
+  } else {
+    std::fprintf(stderr, "failed to save package index\n");
   }
 }
 
@@ -283,11 +594,10 @@ Settings &Context::getSettings(std::string_view path, Settings defValue) {
 Settings &Context::getSettingsFor(const std::shared_ptr<Alternative> &alt,
                                   std::string_view path, Settings defValue) {
   if (path.empty()) {
-    return *settings.emplace(alt->manifest().id(), std::move(defValue)).first;
+    return *settings.emplace(alt->id().str(), std::move(defValue)).first;
   }
 
-  auto result =
-      &*settings.emplace(alt->manifest().id(), Settings::object_t{}).first;
+  auto result = &*settings.emplace(alt->id().str(), Settings::object_t{}).first;
   while (!path.empty()) {
     auto [chunk, rest] = splitOnce(path, '/');
     path = rest;
@@ -301,6 +611,212 @@ Settings &Context::getSettingsFor(const std::shared_ptr<Alternative> &alt,
   return *result;
 }
 
+std::vector<std::string> Context::splitSettingsPath(std::string_view path) {
+  std::vector<std::string> result;
+  while (!path.empty()) {
+    auto [chunk, rest] = splitOnce(path, '/');
+    path = rest;
+    result.emplace_back(chunk);
+  }
+  return result;
+}
+
+void Context::commitSettings(std::string_view path) {
+  recordSettings(splitSettingsPath(path), getSettings(path));
+}
+
+void Context::commitSettingsFor(const std::shared_ptr<Alternative> &alt,
+                                std::string_view path) {
+  auto keys = splitSettingsPath(path);
+  keys.insert(keys.begin(), alt->id().str());
+  recordSettings(std::move(keys), getSettingsFor(alt, path));
+}
+
+std::shared_ptr<SettingsSlot>
+Context::getSettingsSlot(std::vector<std::string> keys, Settings defValue) {
+  auto &entry = settingsSlots[keys];
+  if (auto slot = entry.lock()) {
+    return slot;
+  }
+
+  auto slot = std::make_shared<SettingsSlot>();
+  slot->keys = std::move(keys);
+  slot->defValue = std::move(defValue);
+  entry = slot;
+  return slot;
+}
+
+Settings &Context::resolveSettings(SettingsSlot &slot) {
+  if (slot.generation == settingsGeneration) {
+    return *slot.value;
+  }
+
+  auto result = &settings;
+  for (std::size_t i = 0; i < slot.keys.size(); ++i) {
+    auto defValue = i + 1 < slot.keys.size() ? Settings(Settings::object_t{})
+                                             : slot.defValue;
+    result = &*result->emplace(slot.keys[i], std::move(defValue)).first;
+  }
+
+  slot.value = result;
+  slot.generation = settingsGeneration;
+  return *result;
+}
+
+// whether one of the paths contains the other
+static bool settingsPathsOverlap(std::span<const std::string> lhs,
+                                 std::span<const std::string> rhs) {
+  auto size = std::min(lhs.size(), rhs.size());
+  return std::equal(lhs.begin(), lhs.begin() + size, rhs.begin());
+}
+
+// objects are merged key by key, null leaves the value of lower layers
+static void overlaySettings(Settings &base, const Settings &layer) {
+  if (layer.is_null()) {
+    return;
+  }
+
+  if (!base.is_object() || !layer.is_object()) {
+    base = layer;
+    return;
+  }
+
+  for (auto &[key, value] : layer.items()) {
+    overlaySettings(base[key], value);
+  }
+}
+
+std::shared_ptr<const Settings>
+Context::getLayeredSettings(std::span<const SettingsPath> layers) {
+  if (layers.empty()) {
+    static const auto empty = std::make_shared<const Settings>();
+    return empty;
+  }
+
+  auto it = layeredSettings.find(layers);
+  if (it != layeredSettings.end()) {
+    it->second.lastUse = ++layeredSettingsClock;
+    return it->second.value;
+  }
+
+  // stacks that share a prefix share its view, e.g. all titles of an
+  // emulator only merge their own layer onto the cached emulator view
+  auto base = getLayeredSettings(layers.first(layers.size() - 1));
+
+  auto layer = &settings;
+  for (auto &key : layers.back()) {
+    if (!layer->is_object()) {
+      layer = nullptr;
+      break;
+    }
+
+    auto keyIt = layer->find(key);
+    if (keyIt == layer->end()) {
+      layer = nullptr;
+      break;
+    }
+    layer = &*keyIt;
+  }
+
+  // a layer that adds nothing, like a title without own settings, shares
+  // the view below it instead of copying it
+  std::shared_ptr<const Settings> result = base;
+  if (layer != nullptr && !layer->is_null() &&
+      !(layer->is_object() && layer->empty())) {
+    auto merged = std::make_shared<Settings>(*base);
+    overlaySettings(*merged, *layer);
+    result = std::move(merged);
+  }
+
+  if (layeredSettings.size() >= kMaxLayeredSettings) {
+    layeredSettings.erase(std::ranges::min_element(
+        layeredSettings, {},
+        [](const auto &entry) { return entry.second.lastUse; }));
+  }
+
+  layeredSettings.emplace(
+      std::vector(layers.begin(), layers.end()),
+      LayeredSettings{result, ++layeredSettingsClock});
+  return result;
+}
+
+std::shared_ptr<const Settings>
+Context::getLaunchSettings(const std::shared_ptr<Alternative> &alt,
+                           std::string_view title) {
+  std::vector<SettingsPath> layers = {
+      {"config", "settings"},
+      {alt->id().str(), "config", "settings"},
+  };
+
+  if (!title.empty()) {
+    layers.push_back(
+        {alt->id().str(), "titles", std::string(title), "settings"});
+  }
+
+  return getLayeredSettings(layers);
+}
+
+void Context::recordSettings(std::vector<std::string> keys,
+                             const Settings &value) {
+  settingsJournal.record(keys, value);
+
+  // views keep their values for whoever holds them, new lookups merge again
+  std::erase_if(layeredSettings, [&](const auto &entry) {
+    return std::ranges::any_of(entry.first, [&](const SettingsPath &layer) {
+      return settingsPathsOverlap(layer, keys);
+    });
+  });
+
+  // parents and children of the path changed as well. the change may have
+  // replaced objects that their resolved values point into, other slots stay
+  // valid
+  std::vector<std::shared_ptr<SettingsSlot>> changed;
+  auto addChanged = [&](auto it) {
+    auto slot = it->second.lock();
+    if (slot == nullptr) {
+      return settingsSlots.erase(it);
+    }
+
+    slot->generation = 0;
+    changed.push_back(std::move(slot));
+    return std::next(it);
+  };
+
+  // parents, the path and its children are in order
+  std::vector<std::string> parent;
+  for (std::size_t i = 0; i + 1 < keys.size(); ++i) {
+    parent.push_back(keys[i]);
+    if (auto it = settingsSlots.find(parent); it != settingsSlots.end()) {
+      addChanged(it);
+    }
+  }
+
+  for (auto it = settingsSlots.lower_bound(keys);
+       it != settingsSlots.end() && settingsPathsOverlap(keys, it->first) &&
+       it->first.size() >= keys.size();) {
+    it = addChanged(it);
+  }
+
+  // observers may create handles or change settings
+  for (auto &slot : changed) {
+    // observers may disconnect themselves or each other, they are only
+    // marked until the outermost notification of the slot is done
+    ++slot->notifying;
+    for (auto &observer : slot->observers) {
+      if (observer.connected) {
+        observer.fn(resolveSettings(*slot));
+      }
+    }
+
+    if (--slot->notifying == 0) {
+      slot->observers.remove_if(
+          [](const SettingsSlot::Observer &observer) {
+            return !observer.connected;
+          });
+    }
+  }
+}
+
 void Context::editPackageSources(std::span<const Url> add,
                                  std::span<const Url> remove) {
   auto &sources = getSettings("package-sources", Settings::array());
@@ -328,6 +844,7 @@ void Context::editPackageSources(std::span<const Url> add,
 
   if (!removeList.empty() || !addList.empty()) {
     sources = sourcesSet;
+    commitSettings("package-sources");
     sendNotification("package-sources/change",
                      {{"add", addList}, {"remove", removeList}});
 
@@ -337,15 +854,130 @@ void Context::editPackageSources(std::span<const Url> add,
   }
 }
 
+// Install and download types name the archive format, e.g. "zip" or
+// "tar.zst". Without a type the file name decides. Returns an empty string
+// for packages that are not archives.
+static std::string getArchiveType(const std::string &type, const Url &url) {
+  auto result =
+      type.empty() ? url.underlying().fileName().toLower().toStdString() : type;
+
+  if (result.ends_with("zip") || result.contains("tar") ||
+      result.ends_with("tgz") || result.ends_with("tzst")) {
+    return result;
+  }
+
+  return {};
+}
+
+// Size of the buffer between a streamed download and the extractor
+static constexpr std::size_t kStreamBufferSize = 8 * 1024 * 1024;
+// buffered between the reply and the parser of a package source
+static constexpr std::size_t kSourceBufferSize = 1024 * 1024;
+
+// Input bytes between two progress notifications of a tar extraction
+static constexpr std::uint64_t kStreamProgressStep = 4 * 1024 * 1024;
+
+static std::error_code
+extractTarPackage(Context &context, const std::string &packageId,
+                  std::string_view state, std::uint64_t totalBytes,
+                  std::move_only_function<std::size_t(std::span<char>)> read,
+                  Compression compression, const std::string &hash,
+                  const std::filesystem::path &destination) {
+  std::uint64_t processed = 0;
+  std::uint64_t reported = 0;
+
+  std::unique_ptr<ContentHash> contentHash;
+  if (!hash.empty()) {
+    contentHash = ContentHash::create(hash);
+    if (contentHash == nullptr) {
+      return std::make_error_code(std::errc::invalid_argument);
+    }
+  }
+
+  auto ec = extractTarArchive(
+      [&](std::span<char> buffer) {
+        auto size = read(buffer);
+        processed += size;
+
+        if (contentHash) {
+          contentHash->update(buffer.first(size));
+        }
+
+        if (processed - reported >= kStreamProgressStep) {
+          reported = processed;
+          context.sendInstallProgress(packageId, state, processed, totalBytes);
+        }
+        return size;
+      },
+      compression, destination);
+
+  if (!ec && contentHash && !contentHash->verify()) {
+    std::fprintf(stderr, "package '%s' does not match its hash\n",
+                 packageId.c_str());
+    ec = makeHashMismatchError();
+  }
+
+  return ec;
+}
+
 void Context::installPackage(std::string_view id) {
-  // FIXME: support remote packages and archives
-  // FIXME: unpack archive to dataPath
   auto alt = findAlternativeById(id);
   if (alt == nullptr) {
     // FIXME: report error
     return;
   }
 
+  if (!installDependencies(alt)) {
+    sendInstallProgress(id, "failed", 0, 0);
+    return;
+  }
+
+  installAlternative(alt);
+}
+
+void Context::downloadPackage(std::string_view id) {
+  auto alt = findAlternativeById(id);
+  if (alt == nullptr) {
+    // FIXME: report error
+    return;
+  }
+
+  if (!installDependencies(alt)) {
+    sendInstallProgress(id, "failed", 0, 0);
+    return;
+  }
+
+  downloadAlternative(alt);
+}
+
+bool Context::installDependencies(const std::shared_ptr<Alternative> &alt) {
+  DependencyResolver::Result plan;
+  {
+    std::lock_guard lock(mutex);
+    plan = dependencyResolver.resolve(alt);
+  }
+
+  for (auto &requirement : plan.missing) {
+    std::fprintf(stderr, "'%s' requires '%s', no known package provides it\n",
+                 alt->id().str().c_str(), requirement.c_str());
+  }
+
+  if (!plan.missing.empty()) {
+    return false;
+  }
+
+  for (auto &dependency : plan.install) {
+    if (dependency->manifest().install) {
+      installAlternative(dependency);
+    } else {
+      downloadAlternative(dependency);
+    }
+  }
+
+  return true;
+}
+
+void Context::installAlternative(const std::shared_ptr<Alternative> &alt) {
   auto optInstall = alt->manifest().install;
   if (!optInstall) {
     // FIXME: report error
@@ -353,15 +985,349 @@ void Context::installPackage(std::string_view id) {
   }
 
   auto path = alt->manifest().path;
+  auto url = Url(path);
+
+  if (auto type = getArchiveType(optInstall->type, url); !type.empty()) {
+    installArchive(alt->id().str(), std::string(alt->id().display()), url,
+                   type, optInstall->hash);
+    return;
+  }
 
+  // FIXME: support remote packages
+  addInstalledPackage(path);
+}
+
+void Context::downloadAlternative(const std::shared_ptr<Alternative> &alt) {
+  auto &manifest = alt->manifest();
+  if (!manifest.download) {
+    // FIXME: report error
+    return;
+  }
+
+  auto url =
+      Url::makeFromRelative(Url(manifest.source), manifest.download->url);
+  auto type = getArchiveType(manifest.download->type, url);
+  if (type.empty()) {
+    std::fprintf(stderr, "Unsupported download type '%s'\n",
+                 manifest.download->type.c_str());
+    return;
+  }
+
+  installArchive(alt->id().str(), std::string(alt->id().display()), url,
+                 type, manifest.download->hash);
+}
+
+void Context::installArchive(std::string packageId, std::string displayId,
+                             const Url &url, const std::string &type,
+                             std::string hash) {
+  auto destination = dataPath / "packages" / displayId;
+
+  if (type.ends_with("zip")) {
+    auto extract = [=, this](const std::filesystem::path &archive) {
+      extractPackage(packageId, destination, [&](const auto &partPath) {
+        return extractZipArchive(
+            archive, partPath, [&](const ArchiveProgress &progress) {
+              sendInstallProgress(packageId, "extracting",
+                                  progress.extractedBytes,
+                                  progress.totalBytes);
+            });
+      });
+    };
+
+    if (url.isLocalPath() && hash.empty()) {
+      QtConcurrent::run([=] { extract(url.toLocalPath()); });
+      return;
+    }
+
+    // zip needs the central directory at the end of the archive, it cannot
+    // be streamed. The download resumes if a previous install was
+    // interrupted. A local zip with a hash is copied while it is hashed, so
+    // the extracted bytes are the checked ones.
+    auto downloadPath = dataPath / "downloads" / (displayId + ".zip");
+    auto onProgress = [=, this](std::uint64_t downloaded,
+                                std::uint64_t total) {
+      sendInstallProgress(packageId, "downloading", downloaded, total);
+    };
+
+    // the download checks the hash while it arrives
+    url.asyncDownload(downloadPath, onProgress, NetworkPriority::Interactive,
+                      hash)
+        .then(QtFuture::Launch::Async, [=, this](bool downloaded) {
+          if (!downloaded) {
+            std::fprintf(stderr, "failed to download package '%s'\n",
+                         packageId.c_str());
+            sendInstallProgress(packageId, "failed", 0, 0);
+            return;
+          }
+
+          extract(downloadPath);
+
+          std::error_code ec;
+          std::filesystem::remove(downloadPath, ec);
+        });
+    return;
+  }
+
+  auto compression = getCompressionFromName(type);
+
+  if (url.isLocalPath()) {
+    QtConcurrent::run([=, this] {
+      extractPackage(packageId, destination, [&](const auto &partPath) {
+        auto archivePath = url.toLocalPath();
+        std::ifstream input(archivePath, std::ios::binary);
+        if (!input) {
+          return std::make_error_code(std::errc::no_such_file_or_directory);
+        }
+
+        std::error_code ec;
+        auto size = std::filesystem::file_size(archivePath, ec);
+
+        return extractTarPackage(
+            *this, packageId, "extracting", ec ? 0 : size,
+            [&](std::span<char> buffer) -> std::size_t {
+              input.read(buffer.data(), buffer.size());
+              return input.gcount();
+            },
+            compression, hash, partPath);
+      });
+    });
+    return;
+  }
+
+  // the reply only reads from the socket while the extractor keeps up, so
+  // download and extraction overlap without buffering the whole package
+  auto channel = std::make_shared<ByteChannel>(kStreamBufferSize);
+  url.asyncGetStream(channel);
+
+  QtConcurrent::run([=, this] {
+    extractPackage(packageId, destination, [&](const auto &partPath) {
+      auto ec = extractTarPackage(
+          *this, packageId, "downloading", 0,
+          [&](std::span<char> buffer) { return channel->read(buffer); },
+          compression, hash, partPath);
+
+      if (!ec && channel->failed()) {
+        ec = std::make_error_code(std::errc::connection_aborted);
+      }
+      if (ec) {
+        channel->cancel();
+      }
+      return ec;
+    });
+  });
+}
+
+void Context::extractPackage(
+    const std::string &packageId, const std::filesystem::path &destination,
+    std::move_only_function<std::error_code(const std::filesystem::path &)>
+        extract) {
+  sendInstallProgress(packageId, "extracting", 0, 0);
+
+  // extract next to the destination, so that a failed install does not
+  // leave a broken package behind
+  auto partPath = destination;
+  partPath += ".part";
+  std::error_code ec;
+  std::filesystem::remove_all(partPath, ec);
+
+  ec = extract(partPath);
+
+  if (!ec) {
+    std::filesystem::remove_all(destination, ec);
+    std::filesystem::rename(partPath, destination, ec);
+  }
+
+  if (ec) {
+    std::fprintf(stderr, "failed to install package '%s': %s\n",
+                 packageId.c_str(), ec.message().c_str());
+    std::filesystem::remove_all(partPath, ec);
+    sendInstallProgress(packageId, "failed", 0, 0);
+    return;
+  }
+
+  sendInstallProgress(packageId, "installed", 0, 0);
+
+  QMetaObject::invokeMethod(QCoreApplication::instance(), [=, this] {
+    addInstalledPackage(Url(destination).toString());
+  });
+}
+
+void Context::addInstalledPackage(const std::string &path) {
   auto &packages = getSettings("installed-packages", Settings::array());
   auto packagesSet = packages.get<std::set<std::string>>();
   if (packagesSet.insert(path).second) {
     updatePackageSource(Url(path));
     packages = packagesSet;
+    commitSettings("installed-packages");
+  }
+}
+
+void Context::sendInstallProgress(std::string_view id, std::string_view state,
+                                  std::uint64_t extracted,
+                                  std::uint64_t total) {
+  sendNotification("packages/install-progress",
+                   {
+                       {"id", id},
+                       {"state", state},
+                       {"extracted", extracted},
+                       {"total", total},
+                   });
+}
+
+// Number of packages added before a packages/change notification is sent
+// while a source is being replaced
+static constexpr std::size_t kPackageChangesBatchSize = 256;
+
+// Replaces the packages of a source with packages parsed completely. A source
+// whose content hash did not change keeps its packages and only takes the new
+// validators. A zero hash is never compared
+static void replacePackageSource(Context &context, const std::string &key,
+                                 std::vector<Manifest> packages,
+                                 std::uint64_t hash, UrlValidators validators) {
+  std::vector<NotificationArgs> changes;
+  {
+    std::lock_guard lock(context.mutex);
+    if (auto it = context.packageIndex.sources.find(key);
+        it != context.packageIndex.sources.end() && hash != 0 &&
+        it->second.hash == hash) {
+      it->second.validators = std::move(validators);
+      context.packageIndexDirty = true;
+      return;
+    }
+
+    context.resetPackageSource(key);
+    for (auto &package : packages) {
+      context.addSourcePackage(key, std::move(package));
+
+      if (context.pendingPackageAdds.size() >= kPackageChangesBatchSize) {
+        changes.push_back(context.takePackageChanges());
+      }
+    }
+
+    auto &source = context.packageIndex.sources[key];
+    source.hash = hash;
+    source.validators = std::move(validators);
+    changes.push_back(context.takePackageChanges());
+  }
+
+  for (auto &batch : changes) {
+    context.sendPackageChanges(batch);
+  }
+}
+
+// Parses the manifest of a source while it is read and resolves its packages,
+// nothing is added to the context yet. std::nullopt if the manifest is
+// invalid
+template <typename Input>
+static std::optional<std::vector<Manifest>>
+parsePackageSource(const Url &url, Input &&input) {
+  std::vector<Manifest> resolved;
+
+  try {
+    auto root = parseManifestStream(input, [&](Manifest package) {
+      Context::resolveContributedPackage(url, std::move(package), resolved);
+    });
+
+    Context::resolvePackage(url, url, std::move(root), resolved);
+    return resolved;
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "failed to parse manifest from package '%s': %s\n",
+                 url.toString().c_str(), ex.what());
+    return std::nullopt;
+  }
+}
+
+namespace {
+// Reads a ByteChannel as a stream and hashes the bytes that passed
+class ChannelStreamBuf : public std::streambuf {
+public:
+  explicit ChannelStreamBuf(ByteChannel &channel) : m_channel(channel) {}
+
+  std::uint64_t hash() const { return m_hash; }
+
+protected:
+  int_type underflow() override {
+    auto size = m_channel.read(m_buffer);
+    if (size == 0) {
+      return traits_type::eof();
+    }
+
+    m_hash = PackageIndex::hashBytes({m_buffer.data(), size}, m_hash);
+    setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + size);
+    return traits_type::to_int_type(m_buffer[0]);
+  }
+
+private:
+  ByteChannel &m_channel;
+  std::array<char, 64 * 1024> m_buffer;
+  std::uint64_t m_hash = PackageIndex::kHashSeed;
+};
+} // namespace
+
+// Points icons embedded in a repository index to their stored copies
+static void useThumbnails(
+    const std::map<std::string, std::string, std::less<>> &thumbnails,
+    const std::string &entryPath, Manifest &manifest) {
+  if (!manifest.icon.empty()) {
+    if (auto it = thumbnails.find(
+            RepositoryIndex::thumbnailKey(entryPath, manifest.icon));
+        it != thumbnails.end()) {
+      manifest.icon = it->second;
+    }
+  }
+
+  for (auto &package : manifest.contributes.packages) {
+    useThumbnails(thumbnails, entryPath, package);
   }
 }
 
+// Adds all packages of a repository index at once. Embedded icons are stored
+// in dataPath/thumbnails, named by their content, so they need no request of
+// their own.
+static void ingestRepositoryIndex(Context &context, const Url &url,
+                                  std::string_view bytes, std::uint64_t hash,
+                                  UrlValidators validators) {
+  auto key = url.toString();
+  auto index = RepositoryIndex::parse(bytes);
+  if (!index) {
+    std::fprintf(stderr, "failed to load repository index '%s'\n",
+                 key.c_str());
+    return;
+  }
+
+  auto thumbnailsPath = context.dataPath / "thumbnails";
+  std::error_code ec;
+  std::filesystem::create_directories(thumbnailsPath, ec);
+
+  std::map<std::string, std::string, std::less<>> thumbnails;
+  for (auto &[name, data] : index->thumbnails) {
+    auto path =
+        thumbnailsPath / std::to_string(PackageIndex::hashBytes(data));
+    path += std::filesystem::path(name).extension();
+
+    if (!std::filesystem::exists(path, ec)) {
+      std::ofstream output(path, std::ios::binary);
+      if (!output.write(data.data(), data.size())) {
+        continue;
+      }
+    }
+
+    thumbnails.emplace(name, Url(path).toString());
+  }
+
+  // entry paths are relative to the directory of the index
+  auto base = Url(url.underlying().adjusted(QUrl::RemoveFilename));
+  std::vector<Manifest> resolved;
+  for (auto &entry : index->entries) {
+    auto path = Url::makeFromRelative(base, entry.path);
+    useThumbnails(thumbnails, entry.path, entry.manifest);
+    Context::resolvePackage(path, path, std::move(entry.manifest), resolved);
+  }
+
+  replacePackageSource(context, key, std::move(resolved), hash,
+                       std::move(validators));
+}
+
 void Context::updatePackageSource(const Url &url) {
   // FIXME: fetch packages list only
   auto completeUrl = [&] {
@@ -378,34 +1344,118 @@ void Context::updatePackageSource(const Url &url) {
   auto extension =
       std::filesystem::path(completeUrl.underlying().fileName().toStdString())
           .extension();
-  if (extension != ".json") {
+  auto isRepositoryIndex = extension == RepositoryIndex::kExtension;
+  if (extension != ".json" && !isRepositoryIndex) {
     std::fprintf(stderr, "Unsupported package type '%s'\n", extension.c_str());
     return;
   }
 
-  completeUrl.asyncGet()
+  auto key = url.toString();
+  UrlValidators validators;
+  {
+    std::lock_guard lock(mutex);
+    if (auto it = packageIndex.sources.find(key);
+        it != packageIndex.sources.end()) {
+      validators = it->second.validators;
+    }
+  }
+
+  if (completeUrl.isLocalPath()) {
+    QtConcurrent::run([=, this] {
+      auto localValidators = completeUrl.getLocalValidators();
+      if (!validators.empty() && localValidators == validators) {
+        return;
+      }
+
+      std::ifstream input(completeUrl.toLocalPath(), std::ios::binary);
+      if (!input) {
+        std::fprintf(stderr, "failed to open package source '%s'\n",
+                     key.c_str());
+        return;
+      }
+
+      if (isRepositoryIndex) {
+        std::string bytes(std::istreambuf_iterator<char>(input), {});
+        ingestRepositoryIndex(*this, url, bytes, 0,
+                              std::move(localValidators));
+        return;
+      }
+
+      if (auto packages = parsePackageSource(url, input)) {
+        replacePackageSource(*this, key, std::move(*packages), 0,
+                             std::move(localValidators));
+      }
+    });
+    return;
+  }
+
+  if (!isRepositoryIndex) {
+    // parsed while it arrives, the reply only reads on while the parser
+    // keeps up
+    auto channel = std::make_shared<ByteChannel>(kSourceBufferSize);
+    auto fetch = completeUrl.asyncGetStreamIfModified(channel, validators);
+
+    QtConcurrent::run([=, this] {
+      ChannelStreamBuf buffer(*channel);
+      std::istream input(&buffer);
+
+      // a source that was not modified leaves the channel empty
+      auto empty = input.peek() == std::istream::traits_type::eof();
+      std::optional<std::vector<Manifest>> packages;
+      if (!empty) {
+        packages = parsePackageSource(url, input);
+        if (!packages) {
+          // stops the reply, the parser reported why
+          channel->cancel();
+          return;
+        }
+      }
+
+      UrlFetchResult fetchResult;
+      try {
+        fetchResult = fetch.result();
+      } catch (const std::exception &ex) {
+        std::fprintf(stderr,
+                     "failed to fetch package source from '%s': %s\n",
+                     key.c_str(), ex.what());
+        return;
+      }
+
+      // a reply that broke off leaves the packages of the last version
+      if (packages && !channel->failed()) {
+        replacePackageSource(*this, key, std::move(*packages), buffer.hash(),
+                             std::move(fetchResult.validators));
+      }
+    });
+    return;
+  }
+
+  completeUrl.asyncGetIfModified(validators)
       .then(QtFuture::Launch::Async,
-            [=, this](QByteArray bytes) {
-              try {
-                if (!bytes.isEmpty()) {
-                  auto manifestJson = nlohmann::json::parse(std::string_view(
-                      reinterpret_cast<char *>(bytes.data()), bytes.size()));
-                  {
-                    std::lock_guard lock(mutex);
-                    addPackage(url, url, manifestJson.get<Manifest>());
-                  }
+            [=, this](UrlFetchResult fetchResult) {
+              if (fetchResult.notModified || fetchResult.bytes.isEmpty()) {
+                return;
+              }
+
+              auto &bytes = fetchResult.bytes;
+              auto data = std::string_view(
+                  reinterpret_cast<char *>(bytes.data()), bytes.size());
+              auto hash = PackageIndex::hashBytes(data);
+
+              {
+                std::lock_guard lock(mutex);
+                if (auto it = packageIndex.sources.find(key);
+                    it != packageIndex.sources.end() &&
+                    it->second.hash == hash) {
+                  // content is the same, only validators changed
+                  it->second.validators = std::move(fetchResult.validators);
+                  packageIndexDirty = true;
+                  return;
                 }
-              } catch (const std::exception &ex) {
-                std::fprintf(
-                    stderr,
-                    "failed to parse manifest from package '%s': %s. "
-                    "manifest: %s\n",
-                    url.toString().c_str(), ex.what(),
-                    std::string(
-                        std::string_view(reinterpret_cast<char *>(bytes.data()),
-                                         bytes.size()))
-                        .c_str());
               }
+
+              ingestRepositoryIndex(*this, url, data, hash,
+                                    std::move(fetchResult.validators));
             })
       .onFailed([=](const std::exception &ex) {
         std::fprintf(stderr, "failed to fetch package source from '%s': %s\n",
@@ -2,56 +2,162 @@
 
 #include "Alternative.hpp"
 #include "AlternativeStorage.hpp"
+#include "Connection.hpp"
+#include "DependencyResolver.hpp"
+#include "NotificationBus.hpp"
+#include "PackageIndex.hpp"
+#include "SettingsJournal.hpp"
 #include "Url.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
 using Settings = nlohmann::json;
 
-class [[nodiscard]] Connection {
-  std::move_only_function<void()> m_destroy;
+struct Context;
 
+// keys of the objects from the settings root
+using SettingsPath = std::vector<std::string>;
+
+// orders layer stacks, allows lookups without copying the stack
+struct SettingsLayersLess {
+  using is_transparent = void;
+
+  bool operator()(std::span<const SettingsPath> lhs,
+                  std::span<const SettingsPath> rhs) const {
+    return std::ranges::lexicographical_compare(lhs, rhs);
+  }
+};
+
+// State shared by all handles of a settings path
+struct SettingsSlot {
+  std::vector<std::string> keys;
+  // inserted if the path does not exist when it is resolved
+  Settings defValue;
+  Settings *value = nullptr;
+  // value is valid while this matches Context::settingsGeneration, reset to
+  // 0 when a change may have moved it
+  std::uint64_t generation = 0;
+  struct Observer {
+    std::move_only_function<void(const Settings &)> fn;
+    bool connected = true;
+  };
+  std::list<Observer> observers;
+  // observers disconnected while this is non-zero are erased once the last
+  // notification finishes
+  unsigned notifying = 0;
+};
+
+// A settings path resolved once. Reads are a pointer dereference until a
+// change elsewhere in the settings invalidates all resolved paths, set records
+// the value in the settings journal and notifies the observers of the path,
+// its parents and its children.
+//
+// Must be used from the UI thread.
+template <typename T> class SettingsHandle {
 public:
-  Connection() = default;
-  Connection(std::move_only_function<void()> destroy)
-      : m_destroy(std::move(destroy)) {}
-  ~Connection() { destroy(); }
-  Connection(Connection &&) = default;
-  Connection &operator=(Connection &&) = default;
-
-  void destroy() {
-    if (auto fn = std::exchange(m_destroy, nullptr)) {
-      fn();
+  SettingsHandle() = default;
+  SettingsHandle(Context &context, std::shared_ptr<SettingsSlot> slot,
+                 T defValue)
+      : m_context(&context), m_slot(std::move(slot)),
+        m_defValue(std::move(defValue)) {}
+
+  // defValue if the setting has a different type
+  T get() const;
+  void set(T value);
+
+  Connection onChanged(std::move_only_function<void(const T &)> observer);
+
+  // calls observer with the current value and on every change
+  Connection bind(std::move_only_function<void(const T &)> observer) {
+    observer(get());
+    return onChanged(std::move(observer));
+  }
+
+private:
+  static T convert(const Settings &value, const T &defValue) {
+    try {
+      return value.template get<T>();
+    } catch (const Settings::exception &) {
+      return defValue;
     }
   }
-};
 
-using Connections = std::vector<Connection>;
+  Context *m_context = nullptr;
+  std::shared_ptr<SettingsSlot> m_slot;
+  T m_defValue{};
+};
 
 struct Context : AlternativeStorage {
   std::filesystem::path configPath;
   std::filesystem::path dataPath;
   Settings settings;
+  // changes to settings are durable once committed to the journal
+  SettingsJournal settingsJournal;
+  // incremented when all settings are replaced, a change of one path only
+  // invalidates the slots of its parents and children, see SettingsHandle
+  std::uint64_t settingsGeneration = 1;
+  std::map<std::vector<std::string>, std::weak_ptr<SettingsSlot>>
+      settingsSlots;
+  Connections settingsObservers;
+  // merged views by layer stack, dropped when one of their layers changes
+  // and evicted least recently used beyond kMaxLayeredSettings
+  struct LayeredSettings {
+    std::shared_ptr<const Settings> value;
+    std::uint64_t lastUse = 0;
+  };
+  static constexpr std::size_t kMaxLayeredSettings = 64;
+  std::map<std::vector<SettingsPath>, LayeredSettings, SettingsLayersLess>
+      layeredSettings;
+  std::uint64_t layeredSettingsClock = 0;
   std::mutex mutex;
 
   AlternativeStorage methods;
   AlternativeStorage views;
 
+  // alternative that handles a method when called without requirements,
+  // valid while methodsGeneration and the selection of its group are the same
+  struct ResolvedMethod {
+    std::shared_ptr<Alternative> alternative;
+    std::shared_ptr<AlternativeGroup> group;
+    Alternative *selected = nullptr;
+    std::uint64_t generation = 0;
+  };
+
+  // indexed by MethodId
+  std::vector<ResolvedMethod> resolvedMethods;
+  // incremented whenever alternatives are added, removed or selected
+  std::uint64_t methodsGeneration = 1;
+
+  // solves dependencies against the index of all alternatives
+  DependencyResolver dependencyResolver{index};
+
+  // ui files of the alternatives, parsed when first shown
+  UiSchemaCache uiSchemaCache;
+
+  PackageIndex packageIndex;
+  bool packageIndexDirty = false;
+
+  // packages/change notifications are queued and sent in batches, see
+  // takePackageChanges
+  std::vector<std::string> pendingPackageAdds;
+  std::vector<std::string> pendingPackageRemoves;
+
   std::set<std::shared_ptr<Alternative>> activeList;
 
-  std::map<std::string,
-           std::list<std::move_only_function<void(const NotificationArgs &)>>,
-           std::less<>>
-      notificationHandlers;
+  NotificationBus notifications;
 
   Context();
 
   void addAlternative(std::shared_ptr<Alternative> alternative);
+  void
+  removeAlternativeFromAll(const std::shared_ptr<Alternative> &alternative);
   void selectAlternative(std::string_view kind, std::string_view groupId,
                          std::shared_ptr<Alternative> alternative);
 
@@ -61,19 +167,52 @@ struct Context : AlternativeStorage {
 
   std::error_code hideView(std::string_view name);
 
-  void addPackage(const Url &source, const Url &path, Manifest &&manifest);
+  static void resolvePackage(const Url &source, const Url &path,
+                             Manifest &&manifest,
+                             std::vector<Manifest> &result);
+  static void resolveContributedPackage(const Url &path, Manifest &&manifest,
+                                        std::vector<Manifest> &result);
+  void addResolvedPackage(Manifest manifest);
+  PackageIndex::Source &resetPackageSource(std::string_view url);
+  void addSourcePackage(std::string_view url, Manifest manifest);
 
+  // thread safe, see NotificationBus
   void sendNotification(std::string_view name, const NotificationArgs &args);
+  // moves the queued package changes into a packages/change payload, null if
+  // there are none. called with mutex held, the payload is sent by
+  // sendPackageChanges once it is released so subscribers can take it
+  NotificationArgs takePackageChanges();
+  void sendPackageChanges(const NotificationArgs &changes);
 
   Connection createNotificationHandler(
       std::string name,
-      std::move_only_function<void(const NotificationArgs &)> handler);
+      std::move_only_function<void(const NotificationArgs &)> handler,
+      NotificationExecutor executor = NotificationExecutor::Inline);
+
+  // alternative that handles method, resolutions without requirements are
+  // cached in resolvedMethods
+  std::shared_ptr<Alternative>
+  findMethodAlternative(MethodId method,
+                        const AlternativeRequirements &requirements);
 
   void callMethod(
       std::string_view name, const AlternativeRequirements &requirements,
       const MethodCallArgs &args,
       std::move_only_function<void(const MethodCallResult &)> responseHandler);
 
+  // resolves with the response or an error object, Timeout and Cancelled
+  // included; the alternative runs on the executor of options
+  QFuture<MethodCallResult>
+  callMethodAsync(std::string name, AlternativeRequirements requirements,
+                  MethodCallArgs args, MethodCallOptions options = {});
+  QFuture<MethodCallResult> showViewAsync(std::string name,
+                                          MethodCallArgs args = {},
+                                          MethodCallOptions options = {});
+  QFuture<MethodCallResult>
+  dispatchMethodCall(std::shared_ptr<Alternative> alternative,
+                     std::string name, MethodCallArgs args,
+                     MethodCallOptions options);
+
   auto createShowErrorFn(std::move_only_function<void(const MethodCallResult &)>
                              responseHandler = nullptr) {
     auto impl = [this, responseHandler = std::move(responseHandler)](
@@ -112,12 +251,108 @@ struct Context : AlternativeStorage {
 
   void loadSettings();
   void saveSettings();
+  void loadPackageIndex();
+  void savePackageIndex();
   Settings &getSettings(std::string_view path, Settings defValue = nullptr);
   Settings &getSettingsFor(const std::shared_ptr<Alternative> &alt,
                            std::string_view path, Settings defValue = nullptr);
+  // records the current value at path, call after changing it
+  void commitSettings(std::string_view path);
+  void commitSettingsFor(const std::shared_ptr<Alternative> &alt,
+                         std::string_view path);
+
+  template <typename T>
+  SettingsHandle<T> settingsHandle(std::string_view path, T defValue = {}) {
+    return {*this, getSettingsSlot(splitSettingsPath(path), defValue),
+            defValue};
+  }
+  template <typename T>
+  SettingsHandle<T> settingsHandleFor(const std::shared_ptr<Alternative> &alt,
+                                      std::string_view path,
+                                      T defValue = {}) {
+    auto keys = splitSettingsPath(path);
+    keys.insert(keys.begin(), alt->id().str());
+    return {*this, getSettingsSlot(std::move(keys), defValue), defValue};
+  }
+
+  std::shared_ptr<SettingsSlot> getSettingsSlot(std::vector<std::string> keys,
+                                                Settings defValue);
+  Settings &resolveSettings(SettingsSlot &slot);
+  // merges the settings at layers, later layers override earlier ones. The
+  // result is cached until a layer changes through a commit or a handle, it
+  // never changes for its holders
+  std::shared_ptr<const Settings>
+  getLayeredSettings(std::span<const SettingsPath> layers);
+
+  // global, alternative and per title settings, title may be empty
+  std::shared_ptr<const Settings>
+  getLaunchSettings(const std::shared_ptr<Alternative> &alt,
+                    std::string_view title);
+
+  // journals value and notifies the observers of keys
+  void recordSettings(std::vector<std::string> keys, const Settings &value);
+  static std::vector<std::string> splitSettingsPath(std::string_view path);
   void editPackageSources(std::span<const Url> add,
                           std::span<const Url> remove);
+  // install or download a package after the dependencies it is missing
   void installPackage(std::string_view id);
+  void downloadPackage(std::string_view id);
+
+  // starts installs of dependencies that are not present yet, returns false
+  // if some are not provided by any known package
+  bool installDependencies(const std::shared_ptr<Alternative> &alt);
+  void installAlternative(const std::shared_ptr<Alternative> &alt);
+  void downloadAlternative(const std::shared_ptr<Alternative> &alt);
+  void addInstalledPackage(const std::string &path);
+
+  // installs a zip or tar archive into dataPath/packages, tar archives are
+  // extracted while they are downloaded. A non-empty hash is checked while
+  // the archive is read, see ContentHash
+  void installArchive(std::string packageId, std::string displayId,
+                      const Url &url, const std::string &type,
+                      std::string hash);
+
+  // runs extract on a temporary directory that replaces destination on
+  // success, then registers destination as an installed package
+  void extractPackage(
+      const std::string &packageId, const std::filesystem::path &destination,
+      std::move_only_function<std::error_code(const std::filesystem::path &)>
+          extract);
+
+  // sends packages/install-progress, state is extracting, installed or
+  // failed
+  void sendInstallProgress(std::string_view id, std::string_view state,
+                           std::uint64_t extracted, std::uint64_t total);
   void updatePackageSource(const Url &url);
   void updatePackageSources();
 };
+
+template <typename T> T SettingsHandle<T>::get() const {
+  return convert(m_context->resolveSettings(*m_slot), m_defValue);
+}
+
+template <typename T> void SettingsHandle<T>::set(T value) {
+  auto &setting = m_context->resolveSettings(*m_slot);
+  setting = std::move(value);
+  m_context->recordSettings(m_slot->keys, setting);
+}
+
+template <typename T>
+Connection SettingsHandle<T>::onChanged(
+    std::move_only_function<void(const T &)> observer) {
+  auto &observers = m_slot->observers;
+  observers.push_back({
+      [defValue = m_defValue, observer = std::move(observer)](
+          const Settings &value) mutable {
+        observer(convert(value, defValue));
+      },
+  });
+
+  return {[slot = m_slot, it = std::prev(observers.end())] {
+    if (slot->notifying != 0) {
+      it->connected = false;
+    } else {
+      slot->observers.erase(it);
+    }
+  }};
+}
@@ -0,0 +1,175 @@
+#include "Decompressor.hpp"
+
+#include <vector>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+constexpr std::size_t kOutputChunkSize = 256 * 1024;
+
+std::error_code makeDataError() {
+  return std::make_error_code(std::errc::illegal_byte_sequence);
+}
+
+class PlainDecompressor final : public Decompressor {
+  Output m_output;
+
+public:
+  PlainDecompressor(Output output) : m_output(std::move(output)) {}
+
+  std::error_code write(std::span<const char> input) override {
+    return m_output(input);
+  }
+
+  std::error_code finish() override { return {}; }
+};
+
+class GzipDecompressor final : public Decompressor {
+  Output m_output;
+  z_stream m_stream{};
+  std::vector<char> m_buffer;
+  bool m_initialized = false;
+  bool m_streamEnd = false;
+
+public:
+  GzipDecompressor(Output output)
+      : m_output(std::move(output)), m_buffer(kOutputChunkSize) {
+    // 32 enables gzip and zlib header detection
+    m_initialized = inflateInit2(&m_stream, 32 + MAX_WBITS) == Z_OK;
+  }
+
+  ~GzipDecompressor() override {
+    if (m_initialized) {
+      inflateEnd(&m_stream);
+    }
+  }
+
+  std::error_code write(std::span<const char> input) override {
+    if (!m_initialized) {
+      return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    m_stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    m_stream.avail_in = static_cast<uInt>(input.size());
+
+    while (true) {
+      if (m_streamEnd) {
+        if (m_stream.avail_in == 0) {
+          return {};
+        }
+
+        // next member of a concatenated gzip file
+        inflateReset(&m_stream);
+        m_streamEnd = false;
+      }
+
+      m_stream.next_out = reinterpret_cast<Bytef *>(m_buffer.data());
+      m_stream.avail_out = static_cast<uInt>(m_buffer.size());
+
+      auto ret = inflate(&m_stream, Z_NO_FLUSH);
+      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        return makeDataError();
+      }
+
+      m_streamEnd = ret == Z_STREAM_END;
+
+      auto produced = m_buffer.size() - m_stream.avail_out;
+      if (produced != 0) {
+        if (auto ec = m_output(std::span(m_buffer).first(produced))) {
+          return ec;
+        }
+      }
+
+      // a full output buffer means inflate may still hold pending output
+      if (!m_streamEnd && m_stream.avail_in == 0 &&
+          m_stream.avail_out != 0) {
+        return {};
+      }
+    }
+  }
+
+  std::error_code finish() override {
+    return m_streamEnd ? std::error_code{} : makeDataError();
+  }
+};
+
+#ifdef HAVE_ZSTD
+class ZstdDecompressor final : public Decompressor {
+  Output m_output;
+  ZSTD_DStream *m_stream = ZSTD_createDStream();
+  std::vector<char> m_buffer;
+  bool m_frameEnd = false;
+
+public:
+  ZstdDecompressor(Output output)
+      : m_output(std::move(output)), m_buffer(ZSTD_DStreamOutSize()) {}
+
+  ~ZstdDecompressor() override { ZSTD_freeDStream(m_stream); }
+
+  std::error_code write(std::span<const char> input) override {
+    if (m_stream == nullptr) {
+      return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    ZSTD_inBuffer in{input.data(), input.size(), 0};
+
+    while (true) {
+      ZSTD_outBuffer out{m_buffer.data(), m_buffer.size(), 0};
+      auto ret = ZSTD_decompressStream(m_stream, &out, &in);
+      if (ZSTD_isError(ret)) {
+        return makeDataError();
+      }
+
+      m_frameEnd = ret == 0;
+
+      if (out.pos != 0) {
+        if (auto ec = m_output(std::span(m_buffer).first(out.pos))) {
+          return ec;
+        }
+      }
+
+      if (in.pos == in.size && out.pos < out.size) {
+        return {};
+      }
+    }
+  }
+
+  std::error_code finish() override {
+    return m_frameEnd ? std::error_code{} : makeDataError();
+  }
+};
+#endif
+} // namespace
+
+std::unique_ptr<Decompressor> Decompressor::create(Compression compression,
+                                                   Output output) {
+  switch (compression) {
+  case Compression::None:
+    return std::make_unique<PlainDecompressor>(std::move(output));
+  case Compression::Gzip:
+    return std::make_unique<GzipDecompressor>(std::move(output));
+  case Compression::Zstd:
+#ifdef HAVE_ZSTD
+    return std::make_unique<ZstdDecompressor>(std::move(output));
+#else
+    return nullptr;
+#endif
+  }
+
+  return nullptr;
+}
+
+Compression getCompressionFromName(std::string_view name) {
+  // also covers .tgz and .tzst
+  if (name.ends_with("gz")) {
+    return Compression::Gzip;
+  }
+  if (name.ends_with("zst")) {
+    return Compression::Zstd;
+  }
+  return Compression::None;
+}
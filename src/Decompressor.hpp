@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+enum class Compression {
+  None,
+  Gzip,
+  Zstd,
+};
+
+// Streaming decompressor, input can be split at any byte. Decompressed data
+// is passed to the output function in chunks, an error returned by it stops
+// decompression.
+class Decompressor {
+public:
+  using Output =
+      std::move_only_function<std::error_code(std::span<const char>)>;
+
+  virtual ~Decompressor() = default;
+
+  virtual std::error_code write(std::span<const char> input) = 0;
+
+  // reports truncated input
+  virtual std::error_code finish() = 0;
+
+  // returns nullptr if the compression is not supported by this build
+  static std::unique_ptr<Decompressor> create(Compression compression,
+                                              Output output);
+};
+
+// detects compression from a download type or file name, e.g. "tar.zst"
+Compression getCompressionFromName(std::string_view name);
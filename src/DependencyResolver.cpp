@@ -0,0 +1,236 @@
+#include "DependencyResolver.hpp"
+#include "Alternative.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+std::vector<DependencyResolver::Key>
+DependencyResolver::getRequirements(const Manifest &manifest) {
+  auto &dependencies = manifest.dependencies;
+  std::vector<Key> result;
+
+  for (auto atom : dependencies.alternativeAtoms) {
+    result.push_back(makeKey(Kind::Alternative, atom));
+  }
+  for (auto atom : dependencies.viewAtoms) {
+    result.push_back(makeKey(Kind::View, atom));
+  }
+  for (auto atom : dependencies.methodAtoms) {
+    result.push_back(makeKey(Kind::Method, atom));
+  }
+  for (auto &package : dependencies.packages) {
+    result.push_back(makeKey(Kind::Name, internAtom(package.name)));
+  }
+
+  return result;
+}
+
+std::vector<DependencyResolver::Key>
+DependencyResolver::getProvidedKeys(const Manifest &manifest) {
+  auto &contributes = manifest.contributes;
+  std::vector<Key> result;
+
+  if (manifest.nameAtom != kNullAtom) {
+    result.push_back(makeKey(Kind::Name, manifest.nameAtom));
+  }
+  for (auto atom : contributes.alternativeAtoms) {
+    result.push_back(makeKey(Kind::Alternative, atom));
+  }
+  for (auto atom : contributes.viewAtoms) {
+    result.push_back(makeKey(Kind::View, atom));
+  }
+  for (auto atom : contributes.methodAtoms) {
+    result.push_back(makeKey(Kind::Method, atom));
+  }
+
+  return result;
+}
+
+std::string DependencyResolver::getKeyName(Key key) {
+  std::string result;
+  switch (static_cast<Kind>(key >> 32)) {
+  case Kind::Alternative:
+    result = "alternative:";
+    break;
+  case Kind::View:
+    result = "view:";
+    break;
+  case Kind::Method:
+    result = "method:";
+    break;
+  default:
+    result = "package:";
+    break;
+  }
+
+  result += getAtomName(static_cast<Atom>(key));
+  return result;
+}
+
+const DependencyResolver::Solution &DependencyResolver::solve(Key key) {
+  if (auto it = m_solutions.find(key); it != m_solutions.end()) {
+    return it->second;
+  }
+
+  if (auto it = m_provisional.find(key); it != m_provisional.end()) {
+    // rests on a key still being solved, so does the solution of the caller
+    m_lowestHit = std::min(m_lowestHit, it->second.lowestHit);
+    return it->second.solution;
+  }
+
+  static const Solution kInProgress{.satisfied = true};
+  auto depth = m_solving.size();
+  if (auto [it, inserted] = m_solving.try_emplace(key, depth); !inserted) {
+    // a provider depends on itself, it is part of the install set already.
+    // solutions up to this key rest on that assumption
+    m_lowestHit = std::min(m_lowestHit, it->second);
+    return kInProgress;
+  }
+
+  auto outerLowestHit = std::exchange(m_lowestHit, kNoHit);
+
+  Solution best;
+  auto bestCost = std::numeric_limits<std::size_t>::max();
+
+  auto providers = m_index.findByKey(static_cast<Kind>(key >> 32),
+                                     static_cast<Atom>(key));
+  for (auto &provider : providers) {
+    auto &manifest = provider->manifest();
+    if (!manifest.install && !manifest.download) {
+      best = {.satisfied = true};
+      break;
+    }
+
+    auto requirements = getRequirements(manifest);
+    std::size_t cost = 1;
+    bool satisfied = true;
+
+    for (auto requirement : requirements) {
+      m_dependents[requirement].insert(key);
+
+      // references stay valid while other solutions are inserted
+      auto &solution = solve(requirement);
+      if (!solution.satisfied) {
+        satisfied = false;
+        break;
+      }
+      cost += solution.cost;
+    }
+
+    if (satisfied && cost < bestCost) {
+      bestCost = cost;
+      best = {
+          .satisfied = true,
+          .provider = provider,
+          .requirements = std::move(requirements),
+          .cost = cost,
+      };
+    }
+  }
+
+  m_solving.erase(key);
+
+  // solutions that assumed this key or a deeper one is satisfied are stale
+  // now that it is answered
+  std::erase_if(m_provisional, [&](const auto &entry) {
+    return entry.second.lowestHit >= depth;
+  });
+
+  // a solution that assumed a key further up the stack is satisfied is only
+  // an answer until that key is solved
+  auto provisional = m_lowestHit < depth;
+  const Solution *result;
+  if (provisional) {
+    result = &m_provisional
+                  .insert_or_assign(key, Provisional{std::move(best),
+                                                     m_lowestHit})
+                  .first->second.solution;
+  } else {
+    result = &m_solutions.insert_or_assign(key, std::move(best))
+                  .first->second;
+  }
+
+  m_lowestHit = std::min(outerLowestHit, provisional ? m_lowestHit : kNoHit);
+  return *result;
+}
+
+void DependencyResolver::invalidate(Key key) {
+  std::vector<Key> pending{key};
+
+  while (!pending.empty()) {
+    auto current = pending.back();
+    pending.pop_back();
+    m_solutions.erase(current);
+
+    if (auto it = m_dependents.find(current); it != m_dependents.end()) {
+      pending.insert(pending.end(), it->second.begin(), it->second.end());
+      m_dependents.erase(it);
+    }
+  }
+}
+
+void DependencyResolver::collect(
+    const Solution &solution,
+    std::unordered_set<const Alternative *> &visited, Result &result) {
+  if (solution.provider == nullptr ||
+      !visited.insert(solution.provider.get()).second) {
+    return;
+  }
+
+  for (auto requirement : solution.requirements) {
+    collect(solve(requirement), visited, result);
+  }
+
+  result.install.push_back(solution.provider);
+}
+
+void DependencyResolver::collectMissing(Key key,
+                                        std::unordered_set<Key> &visited,
+                                        Result &result) {
+  if (!visited.insert(key).second) {
+    return;
+  }
+
+  auto providers = m_index.findByKey(static_cast<Kind>(key >> 32),
+                                     static_cast<Atom>(key));
+  if (providers.empty()) {
+    result.missing.push_back(getKeyName(key));
+    return;
+  }
+
+  for (auto &provider : providers) {
+    for (auto requirement : getRequirements(provider->manifest())) {
+      if (!solve(requirement).satisfied) {
+        collectMissing(requirement, visited, result);
+      }
+    }
+  }
+}
+
+DependencyResolver::Result
+DependencyResolver::resolve(const std::shared_ptr<Alternative> &alternative) {
+  std::lock_guard lock(m_mutex);
+
+  Result result;
+  std::unordered_set<const Alternative *> visited{alternative.get()};
+  std::unordered_set<Key> visitedMissing;
+
+  for (auto requirement : getRequirements(alternative->manifest())) {
+    auto &solution = solve(requirement);
+    if (solution.satisfied) {
+      collect(solution, visited, result);
+    } else {
+      collectMissing(requirement, visitedMissing, result);
+    }
+  }
+
+  return result;
+}
+
+void DependencyResolver::invalidateProvided(const Alternative &alternative) {
+  std::lock_guard lock(m_mutex);
+  for (auto key : getProvidedKeys(alternative.manifest())) {
+    invalidate(key);
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "AlternativeIndex.hpp"
+#include "Atom.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Alternative;
+struct Manifest;
+
+// Turns Manifest::dependencies into the packages that have to be installed.
+// Every required alternative group, view, method or package name is provided
+// by the alternatives that contribute it. A requirement with a provider that
+// needs no install is satisfied as is, otherwise the installable provider
+// with the smallest install set of its own is chosen.
+//
+// Solutions are memoized per requirement. Adding or removing an alternative
+// invalidates only the requirements it provides and the requirements whose
+// solutions depend on them, everything else is reused by the next resolve.
+class DependencyResolver {
+public:
+  struct Result {
+    // dependencies first, the resolved alternative itself is not included
+    std::vector<std::shared_ptr<Alternative>> install;
+    // requirements without any provider, e.g. "method:firmware/load"
+    std::vector<std::string> missing;
+  };
+
+  explicit DependencyResolver(const AlternativeIndex &index)
+      : m_index(index) {}
+
+  // the index must not change meanwhile, callers hold the lock that guards
+  // it, Context::mutex for the context index
+  Result resolve(const std::shared_ptr<Alternative> &alternative);
+
+  // must be called after alternative was added to or removed from the index
+  void onAdded(const Alternative &alternative) {
+    invalidateProvided(alternative);
+  }
+  void onRemoved(const Alternative &alternative) {
+    invalidateProvided(alternative);
+  }
+
+private:
+  using Kind = AlternativeIndex::KeyKind;
+  using Key = std::uint64_t;
+
+  struct Solution {
+    bool satisfied = false;
+    // nullptr if a provider needs no install
+    std::shared_ptr<Alternative> provider;
+    std::vector<Key> requirements;
+    std::size_t cost = 0;
+  };
+
+  static Key makeKey(Kind kind, Atom atom) {
+    return (static_cast<Key>(kind) << 32) | atom;
+  }
+
+  static std::vector<Key> getRequirements(const Manifest &manifest);
+  static std::vector<Key> getProvidedKeys(const Manifest &manifest);
+  static std::string getKeyName(Key key);
+
+  void invalidateProvided(const Alternative &alternative);
+  const Solution &solve(Key key);
+  void invalidate(Key key);
+  void collect(const Solution &solution,
+               std::unordered_set<const Alternative *> &visited,
+               Result &result);
+  // reports the requirements below key that nothing provides
+  void collectMissing(Key key, std::unordered_set<Key> &visited,
+                      Result &result);
+
+  const AlternativeIndex &m_index;
+  std::mutex m_mutex;
+  std::unordered_map<Key, Solution> m_solutions;
+  // requirements whose solutions used the key
+  std::unordered_map<Key, std::unordered_set<Key>> m_dependents;
+  // keys being solved by their depth in the search
+  std::unordered_map<Key, std::size_t> m_solving;
+  // smallest depth of a key being solved that the current search reached
+  static constexpr auto kNoHit = std::numeric_limits<std::size_t>::max();
+  std::size_t m_lowestHit = kNoHit;
+  // solutions that rest on a key further up, valid until that key is solved
+  struct Provisional {
+    Solution solution;
+    // depth of the key it rests on
+    std::size_t lowestHit;
+  };
+  std::unordered_map<Key, Provisional> m_provisional;
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace elp {
@@ -12,17 +14,29 @@ using VariantInt = nlohmann::json::number_integer_t;
 using VariantFloat = nlohmann::json::number_float_t;
 using VariantString = nlohmann::json::string_t;
 using VariantValue = nlohmann::json;
+using VariantBinary = nlohmann::json::binary_t;
 
 struct InitializeRequest {
   std::string name;
   std::string version;
   std::vector<std::string> capabilities;
+  // message encodings the sender can decode, most preferred first
+  std::vector<std::string> encodings;
+  // shared memory segment offered for device messages, empty if none
+  std::string deviceChannel;
 };
 
 struct InitializeResponse {
   std::string name;
   std::string version;
   std::vector<std::string> capabilities;
+  // one of the requested encodings, both sides send messages with it after
+  // the response. empty keeps json
+  std::string encoding;
+  // the offered deviceChannel if the server opened it. device messages then
+  // go through it in both directions, each a DeviceMessageNotification as
+  // MessagePack
+  std::string deviceChannel;
 };
 
 struct ExitNotification {
@@ -38,11 +52,15 @@ struct LaunchRequest {
 
 struct LaunchResponse {};
 
+// notification that carries a DeviceMessageNotification
+inline constexpr std::string_view kDeviceMessageMethod = "device/message";
+
 struct DeviceMessageNotification {
   std::string portId;
   std::string deviceType;
   std::string deviceId;
-  std::string data;
+  // binary encodings carry the bytes as they are
+  VariantBinary data;
 };
 
 enum class Severity {
@@ -69,5 +87,95 @@ enum class ErrorCode {
   MethodNotFound = -1,
   InvalidParam = -2,
   NotFound = -3,
+  Timeout = -4,
+  Cancelled = -5,
 };
+
+static void from_json(const nlohmann::json &json, InitializeRequest &object) {
+  if (auto it = json.find("name"); it != json.end()) {
+    object.name = *it;
+  }
+  if (auto it = json.find("version"); it != json.end()) {
+    object.version = *it;
+  }
+  if (auto it = json.find("capabilities"); it != json.end()) {
+    object.capabilities = *it;
+  }
+  if (auto it = json.find("encodings"); it != json.end()) {
+    object.encodings = *it;
+  }
+  if (auto it = json.find("deviceChannel"); it != json.end()) {
+    object.deviceChannel = *it;
+  }
+}
+
+static void to_json(nlohmann::json &json, const InitializeRequest &object) {
+  json["name"] = object.name;
+  json["version"] = object.version;
+  json["capabilities"] = object.capabilities;
+  json["encodings"] = object.encodings;
+  if (!object.deviceChannel.empty()) {
+    json["deviceChannel"] = object.deviceChannel;
+  }
+}
+
+static void from_json(const nlohmann::json &json, InitializeResponse &object) {
+  if (auto it = json.find("name"); it != json.end()) {
+    object.name = *it;
+  }
+  if (auto it = json.find("version"); it != json.end()) {
+    object.version = *it;
+  }
+  if (auto it = json.find("capabilities"); it != json.end()) {
+    object.capabilities = *it;
+  }
+  if (auto it = json.find("encoding"); it != json.end()) {
+    object.encoding = *it;
+  }
+  if (auto it = json.find("deviceChannel"); it != json.end()) {
+    object.deviceChannel = *it;
+  }
+}
+
+static void to_json(nlohmann::json &json, const InitializeResponse &object) {
+  json["name"] = object.name;
+  json["version"] = object.version;
+  json["capabilities"] = object.capabilities;
+  if (!object.encoding.empty()) {
+    json["encoding"] = object.encoding;
+  }
+  if (!object.deviceChannel.empty()) {
+    json["deviceChannel"] = object.deviceChannel;
+  }
+}
+
+static void from_json(const nlohmann::json &json,
+                      DeviceMessageNotification &object) {
+  object.portId = json.at("portId");
+  object.deviceType = json.at("deviceType");
+  object.deviceId = json.at("deviceId");
+
+  // json text has no byte arrays, there data is an array of numbers or the
+  // {"bytes": [...]} object binary values are written as. peers that predate
+  // binary encodings send the bytes as a string
+  auto &data = json.at("data");
+  if (data.is_binary()) {
+    object.data = data.get_binary();
+  } else if (data.is_string()) {
+    auto &bytes = data.get_ref<const std::string &>();
+    object.data = VariantBinary(
+        std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+  } else {
+    auto &bytes = data.is_object() ? data.at("bytes") : data;
+    object.data = VariantBinary(bytes.get<std::vector<std::uint8_t>>());
+  }
+}
+
+static void to_json(nlohmann::json &json,
+                    const DeviceMessageNotification &object) {
+  json["portId"] = object.portId;
+  json["deviceType"] = object.deviceType;
+  json["deviceId"] = object.deviceId;
+  json["data"] = nlohmann::json::binary(object.data);
+}
 } // namespace elp
@@ -1,28 +1,39 @@
 #include "Manifest.hpp"
 
-bool Manifest::match(const AlternativeRequirements &requirements) const {
-  if (!requirements.name.empty()) {
-    if (name != requirements.name) {
-      return false;
-    }
-  }
+static void internApiSetAtoms(Manifest::ApiSet &apiSet) {
+  apiSet.alternativeAtoms = AtomSet::intern(apiSet.alternatives);
+  apiSet.viewAtoms = AtomSet::intern(apiSet.views);
+  apiSet.methodAtoms = AtomSet::intern(apiSet.methods);
+}
 
-  for (auto &capability : requirements.capabilities) {
-    if (!capabilities.contains(capability)) {
-      return false;
-    }
+void Manifest::precompute() {
+  auto display = displayId();
+  auto displaySize = display.size();
+  if (!path.empty()) {
+    display += '-';
+    display += path;
   }
+  cachedId = ManifestId(std::move(display), displaySize);
 
-  for (auto &method : requirements.methods) {
-    if (!contributes.methods.contains(method)) {
-      return false;
-    }
+  nameAtom = internAtom(name);
+  capabilityAtoms = AtomSet::intern(capabilities);
+  internApiSetAtoms(contributes);
+  internApiSetAtoms(dependencies);
+}
+
+bool Manifest::match(const AlternativeRequirements &requirements) const {
+  return match(InternedRequirements(requirements));
+}
+
+bool Manifest::match(const InternedRequirements &requirements) const {
+  if (requirements.name != kNullAtom && nameAtom != requirements.name) {
+    return false;
   }
 
-  for (auto &entity : requirements.alternatives) {
-    if (!contributes.alternatives.contains(entity)) {
-      return false;
-    }
+  if (!capabilityAtoms.includes(requirements.capabilities) ||
+      !contributes.methodAtoms.includes(requirements.methods) ||
+      !contributes.alternativeAtoms.includes(requirements.alternatives)) {
+    return false;
   }
 
   if (requirements.hasSource) {
@@ -35,7 +46,7 @@ bool Manifest::match(const AlternativeRequirements &requirements) const {
     if (launch.has_value() != *requirements.hasLaunch) {
       return false;
     }
-    if (!launch->protocol.empty()) {
+    if (launch && !launch->protocol.empty()) {
       return false;
     }
   }
@@ -85,21 +96,29 @@ void to_json(nlohmann::json &json, const Manifest::Launch &object) {
 void from_json(const nlohmann::json &json, Manifest::Download &object) {
   object.url = json.at("url");
   jsonGetKeyIfExists(json, object.type, "type");
+  jsonGetKeyIfExists(json, object.hash, "hash");
 }
 
 void to_json(nlohmann::json &json, const Manifest::Download &object) {
   json["url"] = object.url;
   json["type"] = object.type;
+  if (!object.hash.empty()) {
+    json["hash"] = object.hash;
+  }
 }
 
 void from_json(const nlohmann::json &json, Manifest::Install &object) {
   object.path = json.at("path");
   jsonGetKeyIfExists(json, object.type, "type");
+  jsonGetKeyIfExists(json, object.hash, "hash");
 }
 
 void to_json(nlohmann::json &json, const Manifest::Install &object) {
   json["path"] = object.path;
   json["type"] = object.type;
+  if (!object.hash.empty()) {
+    json["hash"] = object.hash;
+  }
 }
 
 void from_json(const nlohmann::json &json, Manifest::Command &object) {
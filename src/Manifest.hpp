@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AlternativeRequirements.hpp"
+#include "ManifestId.hpp"
 #include <nlohmann/json_fwd.hpp>
 #include <set>
 #include <string>
@@ -26,11 +27,14 @@ struct Manifest {
   struct Download {
     std::string url;
     std::string type;
+    // optional "<algorithm>:<hex digest>" of the archive, see ContentHash
+    std::string hash;
   };
 
   struct Install {
     std::string path;
     std::string type;
+    std::string hash;
   };
 
   struct ApiSet {
@@ -38,6 +42,10 @@ struct Manifest {
     std::set<std::string> views;
     std::set<std::string> methods;
     std::vector<Manifest> packages;
+
+    AtomSet alternativeAtoms;
+    AtomSet viewAtoms;
+    AtomSet methodAtoms;
   };
 
   std::string source;
@@ -59,6 +67,11 @@ struct Manifest {
   ApiSet contributes;
   ApiSet dependencies;
 
+  // filled by precompute, used by match and alternative lookups
+  Atom nameAtom = kNullAtom;
+  AtomSet capabilityAtoms;
+  ManifestId cachedId;
+
   std::string id() const {
     std::string result = displayId();
     if (!path.empty()) {
@@ -89,7 +102,11 @@ struct Manifest {
     return result;
   }
 
+  // caches atoms and id, must be called again after modifying the manifest
+  void precompute();
+
   bool match(const AlternativeRequirements &requirements) const;
+  bool match(const InternedRequirements &requirements) const;
 };
 
 void from_json(const nlohmann::json &json, Manifest::Launch &object);
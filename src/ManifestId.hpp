@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Immutable manifest id with its hash computed once. Used as the key of
+// alternative lookups so that hot paths neither rebuild nor rehash id strings.
+class ManifestId {
+  std::string m_value;
+  std::size_t m_hash = 0;
+  std::size_t m_displaySize = 0;
+
+public:
+  ManifestId() = default;
+  ManifestId(std::string value, std::size_t displaySize)
+      : m_value(std::move(value)),
+        m_hash(std::hash<std::string_view>{}(m_value)),
+        m_displaySize(displaySize) {}
+  explicit ManifestId(std::string value)
+      : ManifestId(std::move(value), std::string::npos) {}
+
+  const std::string &str() const { return m_value; }
+  std::size_t hash() const { return m_hash; }
+  bool empty() const { return m_value.empty(); }
+
+  // id without the path suffix
+  std::string_view display() const {
+    return std::string_view(m_value).substr(0, m_displaySize);
+  }
+
+  operator std::string_view() const { return m_value; }
+
+  bool operator==(const ManifestId &other) const {
+    return m_hash == other.m_hash && m_value == other.m_value;
+  }
+  bool operator==(std::string_view other) const { return m_value == other; }
+
+  struct Hash {
+    using is_transparent = void;
+
+    std::size_t operator()(const ManifestId &id) const { return id.hash(); }
+    std::size_t operator()(std::string_view id) const {
+      return std::hash<std::string_view>{}(id);
+    }
+  };
+};
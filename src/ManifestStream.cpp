@@ -0,0 +1,149 @@
+#include "ManifestStream.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Builds a DOM of the document like nlohmann's own SAX DOM parser, except
+// that elements of contributes.packages are built one at a time and handed
+// out instead of being appended to the array.
+class ManifestSax {
+  using json = nlohmann::json;
+
+  json m_root;
+  json m_package;
+  std::vector<json *> m_stack;
+  std::vector<std::string> m_keys;
+  std::string m_key;
+  std::size_t m_packagesDepth = 0;
+  std::move_only_function<void(Manifest)> m_onPackage;
+
+public:
+  ManifestSax(std::move_only_function<void(Manifest)> onPackage)
+      : m_onPackage(std::move(onPackage)) {}
+
+  json &root() { return m_root; }
+
+  bool null() { return value(nullptr); }
+  bool boolean(bool val) { return value(val); }
+  bool number_integer(json::number_integer_t val) { return value(val); }
+  bool number_unsigned(json::number_unsigned_t val) { return value(val); }
+  bool number_float(json::number_float_t val, const json::string_t &) {
+    return value(val);
+  }
+  bool string(json::string_t &val) { return value(std::move(val)); }
+  bool binary(json::binary_t &val) { return value(json::binary(val)); }
+
+  bool key(json::string_t &val) {
+    m_key = std::move(val);
+    return true;
+  }
+
+  bool start_object(std::size_t) { return enter(json::object()); }
+
+  bool end_object() {
+    leave();
+    return true;
+  }
+
+  bool start_array(std::size_t) {
+    enter(json::array());
+
+    if (m_stack.size() == 3 && m_keys[1] == "contributes" &&
+        m_keys[2] == "packages") {
+      m_packagesDepth = m_stack.size();
+    }
+    return true;
+  }
+
+  bool end_array() {
+    if (m_stack.size() == m_packagesDepth) {
+      m_packagesDepth = 0;
+    }
+
+    leave();
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &ex) {
+    throw ex;
+  }
+
+private:
+  bool isPackageSlot() const {
+    return m_packagesDepth != 0 && m_stack.size() == m_packagesDepth;
+  }
+
+  json *place(json &&val) {
+    if (m_stack.empty()) {
+      m_root = std::move(val);
+      return &m_root;
+    }
+
+    if (isPackageSlot()) {
+      m_package = std::move(val);
+      return &m_package;
+    }
+
+    auto parent = m_stack.back();
+    if (parent->is_array()) {
+      parent->push_back(std::move(val));
+      return &parent->back();
+    }
+
+    auto &slot = (*parent)[m_key];
+    slot = std::move(val);
+    return &slot;
+  }
+
+  bool value(json &&val) {
+    auto packageSlot = isPackageSlot();
+    place(std::move(val));
+
+    if (packageSlot) {
+      emitPackage();
+    }
+    return true;
+  }
+
+  bool enter(json &&val) {
+    auto parentIsObject = !m_stack.empty() && m_stack.back()->is_object();
+    m_keys.push_back(parentIsObject ? m_key : std::string{});
+    m_stack.push_back(place(std::move(val)));
+    return true;
+  }
+
+  void leave() {
+    m_stack.pop_back();
+    m_keys.pop_back();
+
+    if (isPackageSlot()) {
+      emitPackage();
+    }
+  }
+
+  void emitPackage() {
+    auto package = std::exchange(m_package, nullptr);
+    m_onPackage(package.get<Manifest>());
+  }
+};
+} // namespace
+
+Manifest
+parseManifestStream(std::istream &input,
+                    std::move_only_function<void(Manifest)> onPackage) {
+  ManifestSax sax(std::move(onPackage));
+  nlohmann::json::sax_parse(input, &sax);
+  return sax.root().get<Manifest>();
+}
+
+Manifest
+parseManifestStream(std::string_view input,
+                    std::move_only_function<void(Manifest)> onPackage) {
+  ManifestSax sax(std::move(onPackage));
+  nlohmann::json::sax_parse(input, &sax);
+  return sax.root().get<Manifest>();
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Manifest.hpp"
+
+#include <functional>
+#include <istream>
+#include <string_view>
+
+// Parses a manifest without materializing the whole document. Every entry of
+// the top level contributes.packages array is converted and passed to
+// onPackage as soon as it was read; the returned manifest contains everything
+// else.
+Manifest parseManifestStream(std::istream &input,
+                             std::move_only_function<void(Manifest)> onPackage);
+Manifest parseManifestStream(std::string_view input,
+                             std::move_only_function<void(Manifest)> onPackage);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <stop_token>
+
+enum class MethodExecutor {
+  // the calling thread, before the call returns
+  Caller,
+  // the Qt thread pool
+  Worker,
+  // the UI thread, queued behind pending events
+  Ui,
+};
+
+struct MethodCallOptions {
+  // requesting a stop resolves the call with ErrorCode::Cancelled
+  std::stop_token stopToken;
+  // resolves the call with ErrorCode::Timeout once passed, zero for none
+  std::chrono::milliseconds timeout{0};
+  MethodExecutor executor = MethodExecutor::Caller;
+};
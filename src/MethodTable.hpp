@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Atom.hpp"
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Method names are atoms, so an id is shared with every other use of the
+// same string. Dispatch tables are indexed by them and grow to the largest
+// id they hold.
+using MethodId = Atom;
+
+inline constexpr MethodId kInvalidMethodId = ~MethodId(0);
+
+inline MethodId internMethod(std::string_view name) {
+  return internAtom(name);
+}
+
+// kInvalidMethodId if name was never interned, e.g. no alternative handles it
+inline MethodId findMethod(std::string_view name) {
+  auto atom = findAtom(name);
+  return atom != kNullAtom ? atom : kInvalidMethodId;
+}
+
+inline std::string_view getMethodName(MethodId id) { return getAtomName(id); }
+
+// Handlers indexed by method id
+template <typename Handler> class MethodTable {
+  std::vector<Handler> m_handlers;
+
+public:
+  void set(std::string_view name, Handler handler) {
+    auto id = internMethod(name);
+    if (id >= m_handlers.size()) {
+      m_handlers.resize(id + 1);
+    }
+    m_handlers[id] = std::move(handler);
+  }
+
+  // nullptr if there is no handler for id
+  Handler *find(MethodId id) {
+    if (id >= m_handlers.size() || !m_handlers[id]) {
+      return nullptr;
+    }
+    return &m_handlers[id];
+  }
+
+  Handler *find(std::string_view name) { return find(findMethod(name)); }
+};
@@ -1,55 +1,71 @@
 #include "NativeLauncher.hpp"
 
+MethodTable<NativeLauncher::MethodFn> &NativeLauncher::getMethods() {
+  static auto methods = [] {
+    MethodTable<MethodFn> result;
+    result.set("launch", &NativeLauncher::launch);
+    result.set("terminate", &NativeLauncher::terminate);
+    return result;
+  }();
+  return methods;
+}
+
 void NativeLauncher::callMethod(
     Context &context, std::string_view name, MethodCallArgs args,
     std::move_only_function<void(MethodCallResult)> responseHandler) {
+  callMethodById(context, findMethod(name), std::move(args),
+                 std::move(responseHandler));
+}
 
-  if (name == "launch") {
-    std::error_code ec;
+void NativeLauncher::callMethodById(
+    Context &context, MethodId method, MethodCallArgs args,
+    std::move_only_function<void(MethodCallResult)> responseHandler) {
+  if (auto handler = getMethods().find(method)) {
+    responseHandler((this->**handler)(std::move(args)));
+    return;
+  }
 
-    if (!args.contains("executable")) {
-      responseHandler({{"error", elp::ErrorCode::InvalidParam}});
-      return;
-    }
+  responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
+}
 
-    auto path = args["executable"].get<std::string>();
-    std::vector<std::string> execArgs;
+MethodCallResult NativeLauncher::launch(MethodCallArgs args) {
+  std::error_code ec;
 
-    if (args.contains("args")) {
-      execArgs = args["args"];
-    }
+  if (!args.contains("executable")) {
+    return {{"error", elp::ErrorCode::InvalidParam}};
+  }
 
-    auto process = boost::process::child(path, execArgs, ec, m_process_group);
+  auto path = args["executable"].get<std::string>();
+  std::vector<std::string> execArgs;
 
-    auto pid = process.id();
-    m_processes.emplace(pid, std::move(process));
+  if (args.contains("args")) {
+    execArgs = args["args"];
+  }
 
-    if (ec) {
-      responseHandler({{"error", ec.message()}});
-    } else {
-      responseHandler({{"result", pid}});
-    }
-    return;
+  auto process = boost::process::child(path, execArgs, ec, m_process_group);
+
+  auto pid = process.id();
+  m_processes.emplace(pid, std::move(process));
+
+  if (ec) {
+    return {{"error", ec.message()}};
   }
 
-  if (name == "terminate") {
-    if (!args.contains("pid")) {
-      responseHandler({{"error", elp::ErrorCode::InvalidParam}});
-      return;
-    }
+  return {{"result", pid}};
+}
 
-    boost::process::pid_t pid = args["pid"];
+MethodCallResult NativeLauncher::terminate(MethodCallArgs args) {
+  if (!args.contains("pid")) {
+    return {{"error", elp::ErrorCode::InvalidParam}};
+  }
 
-    if (auto it = m_processes.find(pid); it != m_processes.end()) {
-      it->second.terminate();
-      m_processes.erase(it);
-      responseHandler(MethodCallResult::object());
-    } else {
-      responseHandler({{"error", elp::ErrorCode::NotFound}});
-    }
+  boost::process::pid_t pid = args["pid"];
 
-    return;
+  if (auto it = m_processes.find(pid); it != m_processes.end()) {
+    it->second.terminate();
+    m_processes.erase(it);
+    return MethodCallResult::object();
   }
 
-  responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
+  return {{"error", elp::ErrorCode::NotFound}};
 }
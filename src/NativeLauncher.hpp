@@ -9,8 +9,18 @@ struct NativeLauncher : Alternative {
   void callMethod(
       Context &context, std::string_view name, MethodCallArgs args,
       std::move_only_function<void(MethodCallResult)> responseHandler) override;
+  void callMethodById(
+      Context &context, MethodId method, MethodCallArgs args,
+      std::move_only_function<void(MethodCallResult)> responseHandler) override;
 
 private:
+  // shared by all instances, called on the instance the call went to
+  using MethodFn = MethodCallResult (NativeLauncher::*)(MethodCallArgs args);
+  static MethodTable<MethodFn> &getMethods();
+
+  MethodCallResult launch(MethodCallArgs args);
+  MethodCallResult terminate(MethodCallArgs args);
+
   boost::process::group m_process_group;
   std::map<boost::process::pid_t, boost::process::child, std::less<>>
       m_processes;
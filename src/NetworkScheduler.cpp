@@ -0,0 +1,263 @@
+#include "NetworkScheduler.hpp"
+#include "Url.hpp"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#include <algorithm>
+#include <utility>
+
+// Qt stops reading from the socket once this much is buffered for a reply
+static constexpr qint64 kReadBufferSize = 256 * 1024;
+
+static constexpr int kRefillIntervalMs = 50;
+
+void NetworkTask::abort() {
+  auto &scheduler = NetworkScheduler::instance();
+
+  if (m_queued) {
+    scheduler.dequeue(shared_from_this());
+    return;
+  }
+
+  if (m_reply) {
+    m_reply->abort();
+  }
+}
+
+void NetworkTask::resume() {
+  if (m_reply) {
+    NetworkScheduler::instance().pump(shared_from_this());
+  }
+}
+
+void NetworkTask::setPriority(NetworkPriority priority) {
+  if (m_priority == priority) {
+    return;
+  }
+
+  if (!m_queued) {
+    m_priority = priority;
+    return;
+  }
+
+  auto &scheduler = NetworkScheduler::instance();
+  auto self = shared_from_this();
+  scheduler.dequeue(self);
+  m_priority = priority;
+  scheduler.enqueue(self);
+}
+
+NetworkScheduler &NetworkScheduler::instance() {
+  static auto *scheduler = new NetworkScheduler();
+  return *scheduler;
+}
+
+NetworkScheduler::NetworkScheduler() {
+  m_refillTimer.setInterval(kRefillIntervalMs);
+  QObject::connect(&m_refillTimer, &QTimer::timeout, [this] { refill(); });
+}
+
+std::shared_ptr<NetworkTask>
+NetworkScheduler::get(QNetworkRequest request, NetworkPriority priority,
+                      NetworkCallbacks callbacks) {
+  return enqueue(std::make_shared<NetworkTask>(std::move(request), priority,
+                                               false, std::move(callbacks)));
+}
+
+std::shared_ptr<NetworkTask>
+NetworkScheduler::head(QNetworkRequest request, NetworkPriority priority,
+                       NetworkCallbacks callbacks) {
+  return enqueue(std::make_shared<NetworkTask>(std::move(request), priority,
+                                               true, std::move(callbacks)));
+}
+
+void NetworkScheduler::setMaxConnections(int count) {
+  m_maxConnections = std::max(count, 1);
+  schedule();
+}
+
+void NetworkScheduler::setMaxConnectionsPerHost(int count) {
+  m_maxConnectionsPerHost = std::max(count, 1);
+  schedule();
+}
+
+void NetworkScheduler::setBandwidthLimit(std::uint64_t bytesPerSecond) {
+  m_bandwidthLimit = bytesPerSecond;
+  m_tokens = 0;
+
+  if (m_bandwidthLimit == 0) {
+    m_refillTimer.stop();
+  }
+
+  // continue tasks that waited for the previous limit
+  refill();
+}
+
+std::shared_ptr<NetworkTask>
+NetworkScheduler::enqueue(std::shared_ptr<NetworkTask> task) {
+  auto url = task->m_request.url();
+  task->m_host = url.host() + ":" + QString::number(url.port());
+  task->m_queued = true;
+  m_queues[static_cast<std::size_t>(task->m_priority)].push_back(task);
+  schedule();
+  return task;
+}
+
+void NetworkScheduler::dequeue(const std::shared_ptr<NetworkTask> &task) {
+  std::erase(m_queues[static_cast<std::size_t>(task->m_priority)], task);
+  task->m_queued = false;
+}
+
+void NetworkScheduler::schedule() {
+  std::vector<std::shared_ptr<NetworkTask>> starting;
+  auto running = static_cast<int>(m_running.size());
+
+  for (auto &queue : m_queues) {
+    for (auto it = queue.begin();
+         it != queue.end() && running < m_maxConnections;) {
+      auto &hostConnections = m_hostConnections[(*it)->m_host];
+      if (hostConnections >= m_maxConnectionsPerHost) {
+        // later requests to other hosts may still start
+        ++it;
+        continue;
+      }
+
+      ++hostConnections;
+      ++running;
+      starting.push_back(std::move(*it));
+      it = queue.erase(it);
+    }
+  }
+
+  // callbacks of started tasks may queue new requests
+  for (auto &task : starting) {
+    start(std::move(task));
+  }
+}
+
+void NetworkScheduler::start(std::shared_ptr<NetworkTask> task) {
+  auto manager = Url::getNetworkAccessManager();
+  auto reply = task->m_head ? manager->head(task->m_request)
+                            : manager->get(task->m_request);
+  reply->setReadBufferSize(kReadBufferSize);
+
+  task->m_queued = false;
+  task->m_reply = reply;
+  m_running.push_back(task);
+
+  QObject::connect(reply, &QNetworkReply::readyRead, reply,
+                   [this, task] { pump(task); });
+  QObject::connect(reply, &QNetworkReply::finished, reply,
+                   [this, task] { pump(task); });
+
+  if (task->m_callbacks.onStarted) {
+    task->m_callbacks.onStarted(reply);
+  }
+}
+
+void NetworkScheduler::pump(const std::shared_ptr<NetworkTask> &task) {
+  QNetworkReply *reply = task->m_reply;
+  if (reply == nullptr) {
+    return;
+  }
+
+  while (reply->bytesAvailable() > 0) {
+    auto limit = kUnlimited;
+    if (task->m_callbacks.space) {
+      limit = task->m_callbacks.space();
+    }
+
+    if (m_bandwidthLimit != 0) {
+      if (m_tokens == 0) {
+        task->m_waitingForBandwidth = true;
+        if (!m_refillTimer.isActive()) {
+          m_refillTimer.start();
+        }
+        return;
+      }
+
+      limit = std::min(limit, m_tokens);
+    }
+
+    if (limit == 0) {
+      // the consumer calls resume
+      return;
+    }
+
+    auto bytes = reply->read(static_cast<qint64>(
+        std::min<std::uint64_t>(limit, reply->bytesAvailable())));
+    if (bytes.isEmpty()) {
+      break;
+    }
+
+    if (m_bandwidthLimit != 0) {
+      m_tokens -= std::min<std::uint64_t>(m_tokens, bytes.size());
+    }
+
+    if (task->m_callbacks.onData) {
+      task->m_callbacks.onData(reply, std::move(bytes));
+    }
+
+    if (task->m_reply != reply) {
+      // finished by an abort from onData
+      return;
+    }
+  }
+
+  if (reply->isFinished() && reply->bytesAvailable() == 0) {
+    finish(task);
+  }
+}
+
+void NetworkScheduler::finish(const std::shared_ptr<NetworkTask> &task) {
+  QNetworkReply *reply = std::exchange(task->m_reply, nullptr);
+  if (reply == nullptr) {
+    return;
+  }
+
+  std::erase(m_running, task);
+  if (auto it = m_hostConnections.find(task->m_host);
+      it != m_hostConnections.end() && --it->second <= 0) {
+    m_hostConnections.erase(it);
+  }
+
+  if (task->m_callbacks.onFinished) {
+    task->m_callbacks.onFinished(reply);
+  }
+
+  reply->deleteLater();
+  schedule();
+}
+
+void NetworkScheduler::refill() {
+  // allow bursts of a quarter second
+  auto capacity = std::max<std::uint64_t>(m_bandwidthLimit / 4,
+                                          static_cast<std::uint64_t>(
+                                              kReadBufferSize));
+  m_tokens = std::min(capacity, m_tokens + m_bandwidthLimit *
+                                               kRefillIntervalMs / 1000);
+
+  std::vector<std::shared_ptr<NetworkTask>> waiting;
+  for (auto &task : m_running) {
+    if (std::exchange(task->m_waitingForBandwidth, false)) {
+      waiting.push_back(task);
+    }
+  }
+
+  // tokens go to the most important requests first
+  std::stable_sort(waiting.begin(), waiting.end(),
+                   [](const auto &lhs, const auto &rhs) {
+                     return lhs->m_priority < rhs->m_priority;
+                   });
+
+  for (auto &task : waiting) {
+    pump(task);
+  }
+
+  if (std::none_of(m_running.begin(), m_running.end(), [](const auto &task) {
+        return task->m_waitingForBandwidth;
+      })) {
+    m_refillTimer.stop();
+  }
+}
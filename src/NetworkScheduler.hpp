@@ -0,0 +1,121 @@
+#pragma once
+
+#include <QByteArray>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+
+class QNetworkReply;
+
+enum class NetworkPriority {
+  // explicitly requested by the user, e.g. installs
+  Interactive,
+  // needed by what is on screen, e.g. icons
+  Visible,
+  // refreshes and prefetches
+  Background,
+};
+
+struct NetworkCallbacks {
+  // called once the request was sent
+  std::move_only_function<void(QNetworkReply *)> onStarted;
+
+  // number of bytes onData accepts right now, unlimited if not set. Call
+  // NetworkTask::resume once there is space again
+  std::move_only_function<std::size_t()> space;
+
+  std::move_only_function<void(QNetworkReply *, QByteArray)> onData;
+
+  // all data was passed to onData, the reply is deleted afterwards
+  std::move_only_function<void(QNetworkReply *)> onFinished;
+};
+
+class NetworkTask : public std::enable_shared_from_this<NetworkTask> {
+public:
+  NetworkTask(QNetworkRequest request, NetworkPriority priority, bool head,
+              NetworkCallbacks callbacks)
+      : m_request(std::move(request)), m_priority(priority), m_head(head),
+        m_callbacks(std::move(callbacks)) {}
+
+  // drops a queued request or aborts a running one, onFinished is still
+  // called for a running one
+  void abort();
+
+  // reads data that was held back because space() returned 0
+  void resume();
+
+  void setPriority(NetworkPriority priority);
+
+private:
+  friend class NetworkScheduler;
+
+  QNetworkRequest m_request;
+  NetworkPriority m_priority;
+  bool m_head;
+  NetworkCallbacks m_callbacks;
+  QString m_host;
+  QPointer<QNetworkReply> m_reply;
+  bool m_queued = false;
+  bool m_waitingForBandwidth = false;
+};
+
+// Starts every request of the launcher. Queued requests are started by
+// priority, first in first out within a priority, while the connection limits
+// allow it. Replies are read by the scheduler into the callbacks, limited by
+// a token bucket when a bandwidth limit is set; unread data stays in the
+// socket, so the limit applies to the network as well.
+//
+// Must be used from the UI thread.
+class NetworkScheduler {
+public:
+  static constexpr std::uint64_t kUnlimited =
+      std::numeric_limits<std::uint64_t>::max();
+
+  static NetworkScheduler &instance();
+
+  std::shared_ptr<NetworkTask> get(QNetworkRequest request,
+                                   NetworkPriority priority,
+                                   NetworkCallbacks callbacks);
+  std::shared_ptr<NetworkTask> head(QNetworkRequest request,
+                                    NetworkPriority priority,
+                                    NetworkCallbacks callbacks);
+
+  void setMaxConnections(int count);
+  void setMaxConnectionsPerHost(int count);
+
+  // bytes per second, 0 disables the limit
+  void setBandwidthLimit(std::uint64_t bytesPerSecond);
+
+private:
+  friend class NetworkTask;
+
+  NetworkScheduler();
+
+  std::shared_ptr<NetworkTask> enqueue(std::shared_ptr<NetworkTask> task);
+  void dequeue(const std::shared_ptr<NetworkTask> &task);
+  void schedule();
+  void start(std::shared_ptr<NetworkTask> task);
+  void pump(const std::shared_ptr<NetworkTask> &task);
+  void finish(const std::shared_ptr<NetworkTask> &task);
+  void refill();
+
+  std::array<std::deque<std::shared_ptr<NetworkTask>>, 3> m_queues;
+  std::vector<std::shared_ptr<NetworkTask>> m_running;
+  std::map<QString, int> m_hostConnections;
+  int m_maxConnections = 16;
+  int m_maxConnectionsPerHost = 4;
+
+  std::uint64_t m_bandwidthLimit = 0;
+  std::uint64_t m_tokens = 0;
+  QTimer m_refillTimer;
+};
@@ -0,0 +1,147 @@
+#include "NotificationBus.hpp"
+
+#include <QCoreApplication>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+// subscribers whose handler runs on this thread, innermost last
+static thread_local std::vector<const void *> tDelivering;
+
+Connection NotificationBus::subscribe(std::string topic, Handler handler,
+                                      NotificationExecutor executor) {
+  auto subscriber = std::make_shared<Subscriber>();
+  subscriber->handler = std::move(handler);
+  subscriber->executor = executor;
+
+  {
+    std::lock_guard lock(m_writeMutex);
+    auto topics = std::make_shared<TopicTable>(*m_topics.load());
+    auto &list = (*topics)[topic];
+    auto subscribers =
+        list ? std::make_shared<SubscriberList>(*list)
+             : std::make_shared<SubscriberList>();
+    subscribers->push_back(subscriber);
+    list = std::move(subscribers);
+    m_topics.store(std::move(topics));
+  }
+
+  return {[this, topic = std::move(topic), subscriber] {
+    unsubscribe(topic, subscriber);
+  }};
+}
+
+void NotificationBus::unsubscribe(
+    const std::string &topic, const std::shared_ptr<Subscriber> &subscriber) {
+  {
+    // publishers that still hold the old list skip it from now on. a
+    // handler that disconnects its own subscriber does not wait for itself
+    std::unique_lock lock(subscriber->mutex);
+    subscriber->active = false;
+    auto own = static_cast<unsigned>(
+        std::ranges::count(tDelivering, subscriber.get()));
+    subscriber->idle.wait(lock,
+                          [&] { return subscriber->running == own; });
+  }
+
+  std::lock_guard lock(m_writeMutex);
+  auto topics = std::make_shared<TopicTable>(*m_topics.load());
+  auto it = topics->find(topic);
+  if (it == topics->end()) {
+    return;
+  }
+
+  auto subscribers = std::make_shared<SubscriberList>(*it->second);
+  std::erase(*subscribers, subscriber);
+  if (subscribers->empty()) {
+    topics->erase(it);
+  } else {
+    it->second = std::move(subscribers);
+  }
+  m_topics.store(std::move(topics));
+}
+
+void NotificationBus::publish(std::string_view topic,
+                              const NotificationArgs &args) {
+  auto topics = m_topics.load();
+  auto it = topics->find(topic);
+  if (it == topics->end()) {
+    return;
+  }
+
+  // the snapshot stays alive while handlers subscribe or unsubscribe
+  auto subscribers = it->second;
+  for (auto &subscriber : *subscribers) {
+    switch (subscriber->executor) {
+    case NotificationExecutor::Inline:
+      deliver(*subscriber, args);
+      break;
+
+    case NotificationExecutor::Worker:
+      QtConcurrent::run([subscriber, args] { deliver(*subscriber, args); });
+      break;
+
+    case NotificationExecutor::Ui:
+      enqueueUi(subscriber, args);
+      break;
+    }
+  }
+}
+
+void NotificationBus::enqueueUi(std::shared_ptr<Subscriber> subscriber,
+                                const NotificationArgs &args) {
+  bool schedule;
+  {
+    std::lock_guard lock(m_uiQueue->mutex);
+    schedule = m_uiQueue->pending.empty();
+    m_uiQueue->pending.emplace_back(std::move(subscriber), args);
+  }
+
+  if (schedule) {
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [queue = m_uiQueue] { deliverUi(queue); }, Qt::QueuedConnection);
+  }
+}
+
+void NotificationBus::deliverUi(const std::shared_ptr<UiQueue> &queue) {
+  decltype(queue->pending) batch;
+  {
+    std::lock_guard lock(queue->mutex);
+    batch = std::exchange(queue->pending, {});
+  }
+
+  // in publishing order
+  for (auto &[subscriber, args] : batch) {
+    deliver(*subscriber, args);
+  }
+}
+
+void NotificationBus::deliver(Subscriber &subscriber,
+                              const NotificationArgs &args) {
+  {
+    std::lock_guard lock(subscriber.mutex);
+    if (!subscriber.active) {
+      return;
+    }
+    ++subscriber.running;
+  }
+
+  // a throwing handler must not keep unsubscribe waiting for it
+  struct Running {
+    Subscriber &subscriber;
+
+    ~Running() {
+      tDelivering.pop_back();
+      {
+        std::lock_guard lock(subscriber.mutex);
+        --subscriber.running;
+      }
+      subscriber.idle.notify_all();
+    }
+  };
+
+  tDelivering.push_back(&subscriber);
+  Running running{subscriber};
+  subscriber.handler(args);
+}
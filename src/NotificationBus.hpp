@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Alternative.hpp"
+#include "Connection.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class NotificationExecutor {
+  // on the publishing thread, before publish returns
+  Inline,
+  // on the Qt thread pool, deliveries may run concurrently
+  Worker,
+  // on the UI thread, everything published until the next event loop
+  // iteration is delivered in one batch
+  Ui,
+};
+
+// Delivers notifications to the subscribers of their topic. Publishing reads
+// an immutable snapshot of the subscribers, so it never waits for
+// subscriptions being added or removed; those copy the topic table and swap it
+// in. Subscribers that are disconnected receive nothing from then on, even
+// from snapshots taken before: disconnecting waits for deliveries to the
+// subscriber that already started on other threads. A handler may disconnect
+// itself, but must not wait for one that is disconnecting it in turn.
+class NotificationBus {
+public:
+  using Handler = std::move_only_function<void(const NotificationArgs &)>;
+
+  NotificationBus() = default;
+  NotificationBus(const NotificationBus &) = delete;
+  NotificationBus &operator=(const NotificationBus &) = delete;
+
+  Connection subscribe(std::string topic, Handler handler,
+                       NotificationExecutor executor =
+                           NotificationExecutor::Inline);
+
+  // thread safe
+  void publish(std::string_view topic, const NotificationArgs &args);
+
+private:
+  struct Subscriber {
+    Handler handler;
+    NotificationExecutor executor;
+    std::mutex mutex;
+    std::condition_variable idle;
+    bool active = true;
+    // deliveries running the handler
+    unsigned running = 0;
+  };
+
+  using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+  using TopicTable =
+      std::map<std::string, std::shared_ptr<const SubscriberList>,
+               std::less<>>;
+
+  struct UiQueue {
+    std::mutex mutex;
+    std::vector<std::pair<std::shared_ptr<Subscriber>, NotificationArgs>>
+        pending;
+  };
+
+  void unsubscribe(const std::string &topic,
+                   const std::shared_ptr<Subscriber> &subscriber);
+  void enqueueUi(std::shared_ptr<Subscriber> subscriber,
+                 const NotificationArgs &args);
+  static void deliver(Subscriber &subscriber, const NotificationArgs &args);
+  static void deliverUi(const std::shared_ptr<UiQueue> &queue);
+
+  std::atomic<std::shared_ptr<const TopicTable>> m_topics{
+      std::make_shared<const TopicTable>()};
+  // serializes writers of m_topics
+  std::mutex m_writeMutex;
+  // shared with queued deliveries, which may run after the bus is gone
+  std::shared_ptr<UiQueue> m_uiQueue = std::make_shared<UiQueue>();
+};
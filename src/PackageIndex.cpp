@@ -0,0 +1,248 @@
+#include "PackageIndex.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+
+// Layout, see BinaryStream.hpp for the encoding:
+//
+//   char     magic[4] = "ELPI"
+//   u32      version
+//   u32      source count
+//   source[] { string url, u64 hash, validators, u32 package count,
+//              manifest[] }
+//   validators { string etag, string lastModified, u64 size, i64 mtime,
+//                u64 inode }
+
+static constexpr char kMagic[4] = {'E', 'L', 'P', 'I'};
+
+static void writeApiSet(BinaryWriter &writer,
+                        const Manifest::ApiSet &apiSet) {
+  writer.writeList(apiSet.alternatives);
+  writer.writeList(apiSet.views);
+  writer.writeList(apiSet.methods);
+  writer.write(static_cast<std::uint32_t>(apiSet.packages.size()));
+  for (auto &package : apiSet.packages) {
+    PackageIndex::encodeManifest(writer, package);
+  }
+}
+
+static Manifest::ApiSet readApiSet(BinaryReader &reader) {
+  Manifest::ApiSet result;
+  result.alternatives = reader.readList<std::set<std::string>>();
+  result.views = reader.readList<std::set<std::string>>();
+  result.methods = reader.readList<std::set<std::string>>();
+  auto count = reader.read<std::uint32_t>();
+  result.packages.reserve(count);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    result.packages.push_back(PackageIndex::decodeManifest(reader));
+  }
+  return result;
+}
+
+void PackageIndex::encodeManifest(BinaryWriter &writer,
+                                  const Manifest &manifest) {
+  writer.write(manifest.source);
+  writer.write(manifest.path);
+  writer.write(manifest.name);
+  writer.write(manifest.branch);
+  writer.write(manifest.version);
+  writer.write(manifest.versionTag);
+  writer.write(manifest.tag);
+  writer.write(manifest.license);
+  writer.write(manifest.description);
+  writer.write(manifest.icon);
+  writer.write(manifest.ui);
+
+  writer.write(static_cast<std::uint8_t>(manifest.launch.has_value()));
+  if (auto &launch = manifest.launch) {
+    writer.write(launch->executable);
+    writer.writeList(launch->args);
+    writer.write(launch->interpreter);
+    writer.write(launch->protocol);
+    writer.write(launch->transport);
+    writer.write(launch->configUi);
+  }
+
+  writer.write(static_cast<std::uint8_t>(manifest.download.has_value()));
+  if (auto &download = manifest.download) {
+    writer.write(download->url);
+    writer.write(download->type);
+    writer.write(download->hash);
+  }
+
+  writer.write(static_cast<std::uint8_t>(manifest.install.has_value()));
+  if (auto &install = manifest.install) {
+    writer.write(install->path);
+    writer.write(install->type);
+    writer.write(install->hash);
+  }
+
+  writer.write(static_cast<std::uint32_t>(manifest.commands.size()));
+  for (auto &command : manifest.commands) {
+    writer.write(command.id);
+    writer.write(command.title);
+    writer.write(nlohmann::json(command.args).dump());
+    writer.write(command.binding);
+  }
+
+  writer.writeList(manifest.capabilities);
+  writeApiSet(writer, manifest.contributes);
+  writeApiSet(writer, manifest.dependencies);
+}
+
+Manifest PackageIndex::decodeManifest(BinaryReader &reader) {
+  Manifest result;
+  result.source = reader.readString();
+  result.path = reader.readString();
+  result.name = reader.readString();
+  result.branch = reader.readString();
+  result.version = reader.readString();
+  result.versionTag = reader.readString();
+  result.tag = reader.readString();
+  result.license = reader.readString();
+  result.description = reader.readString();
+  result.icon = reader.readString();
+  result.ui = reader.readString();
+
+  if (reader.read<std::uint8_t>()) {
+    auto &launch = result.launch.emplace();
+    launch.executable = reader.readString();
+    launch.args = reader.readList<std::vector<std::string>>();
+    launch.interpreter = reader.readString();
+    launch.protocol = reader.readString();
+    launch.transport = reader.readString();
+    launch.configUi = reader.readString();
+  }
+
+  if (reader.read<std::uint8_t>()) {
+    auto &download = result.download.emplace();
+    download.url = reader.readString();
+    download.type = reader.readString();
+    download.hash = reader.readString();
+  }
+
+  if (reader.read<std::uint8_t>()) {
+    auto &install = result.install.emplace();
+    install.path = reader.readString();
+    install.type = reader.readString();
+    install.hash = reader.readString();
+  }
+
+  auto commandCount = reader.read<std::uint32_t>();
+  result.commands.reserve(commandCount);
+  for (std::uint32_t i = 0; i < commandCount; ++i) {
+    auto &command = result.commands.emplace_back();
+    command.id = reader.readString();
+    command.title = reader.readString();
+    command.args = nlohmann::json::parse(reader.readString())
+                       .get<std::vector<nlohmann::json>>();
+    command.binding = reader.readString();
+  }
+
+  result.capabilities = reader.readList<std::set<std::string>>();
+  result.contributes = readApiSet(reader);
+  result.dependencies = readApiSet(reader);
+  return result;
+}
+
+bool PackageIndex::load(const std::filesystem::path &path) {
+  namespace bip = boost::interprocess;
+
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec) ||
+      std::filesystem::file_size(path, ec) == 0) {
+    return false;
+  }
+
+  try {
+    bip::file_mapping file(path.c_str(), bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+
+    BinaryReader reader{{static_cast<const char *>(region.get_address()),
+                         region.get_size()}};
+
+    if (!reader.readMagic(kMagic)) {
+      return false;
+    }
+
+    if (reader.read<std::uint32_t>() != kVersion) {
+      return false;
+    }
+
+    decltype(sources) result;
+    auto sourceCount = reader.read<std::uint32_t>();
+    for (std::uint32_t i = 0; i < sourceCount; ++i) {
+      auto url = reader.readString();
+      Source source;
+      source.hash = reader.read<std::uint64_t>();
+      source.validators.etag = reader.readString();
+      source.validators.lastModified = reader.readString();
+      source.validators.size = reader.read<std::uint64_t>();
+      source.validators.mtime = reader.read<std::int64_t>();
+      source.validators.inode = reader.read<std::uint64_t>();
+      auto packageCount = reader.read<std::uint32_t>();
+      source.packages.reserve(packageCount);
+      for (std::uint32_t j = 0; j < packageCount; ++j) {
+        source.packages.push_back(decodeManifest(reader));
+      }
+      result.emplace(std::move(url), std::move(source));
+    }
+
+    sources = std::move(result);
+    return true;
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "failed to load package index '%s': %s\n",
+                 path.c_str(), ex.what());
+    return false;
+  }
+}
+
+bool PackageIndex::save(const std::filesystem::path &path) const {
+  std::string bytes;
+  BinaryWriter writer{bytes};
+  bytes.append(kMagic, sizeof(kMagic));
+  writer.write(kVersion);
+  writer.write(static_cast<std::uint32_t>(sources.size()));
+
+  for (auto &[url, source] : sources) {
+    writer.write(url);
+    writer.write(source.hash);
+    writer.write(source.validators.etag);
+    writer.write(source.validators.lastModified);
+    writer.write(source.validators.size);
+    writer.write(source.validators.mtime);
+    writer.write(source.validators.inode);
+    writer.write(static_cast<std::uint32_t>(source.packages.size()));
+    for (auto &package : source.packages) {
+      encodeManifest(writer, package);
+    }
+  }
+
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+
+  {
+    std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!f.write(bytes.data(), bytes.size())) {
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  return !ec;
+}
+
+std::uint64_t PackageIndex::hashBytes(std::string_view bytes,
+                                      std::uint64_t hash) {
+  // FNV-1a, stable between runs unlike std::hash
+  auto result = hash;
+  for (auto c : bytes) {
+    result ^= static_cast<std::uint8_t>(c);
+    result *= 0x100000001b3;
+  }
+  return result;
+}
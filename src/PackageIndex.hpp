@@ -0,0 +1,38 @@
+#pragma once
+
+#include "BinaryStream.hpp"
+#include "Manifest.hpp"
+#include "UrlValidators.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Cache of resolved package sources, stored in Context::dataPath.
+// Lets the launcher rebuild alternatives at startup without fetching and
+// parsing every manifest again.
+struct PackageIndex {
+  static constexpr std::uint32_t kVersion = 3;
+
+  struct Source {
+    std::uint64_t hash = 0;
+    UrlValidators validators;
+    std::vector<Manifest> packages;
+  };
+
+  std::map<std::string, Source, std::less<>> sources;
+
+  bool load(const std::filesystem::path &path);
+  bool save(const std::filesystem::path &path) const;
+
+  // continues hash, so that a stream can be hashed chunk by chunk
+  static constexpr std::uint64_t kHashSeed = 0xcbf29ce484222325;
+  static std::uint64_t hashBytes(std::string_view bytes,
+                                 std::uint64_t hash = kHashSeed);
+
+  // manifest encoding, shared with RepositoryIndex
+  static void encodeManifest(BinaryWriter &writer, const Manifest &manifest);
+  static Manifest decodeManifest(BinaryReader &reader);
+};
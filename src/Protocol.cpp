@@ -1,13 +1,626 @@
 #include "Protocol.hpp"
 
-struct ElpProtocol : public Protocol {
-    using Protocol::Protocol;
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// error codes reserved by JSON-RPC 2.0, ELP codes are sent as they are
+static constexpr int kParseError = -32700;
+static constexpr int kInvalidRequest = -32600;
+static constexpr int kMethodNotFound = -32601;
+static constexpr int kInvalidParams = -32602;
+static constexpr int kInternalError = -32603;
+
+static constexpr std::string_view kCancelRequest = "$/cancelRequest";
+
+static const char *getErrorMessage(int code) {
+  switch (code) {
+  case kParseError:
+    return "Parse error";
+  case kInvalidRequest:
+    return "Invalid request";
+  case kMethodNotFound:
+    return "Method not found";
+  case kInvalidParams:
+    return "Invalid params";
+  case int(elp::ErrorCode::NotFound):
+    return "Not found";
+  case int(elp::ErrorCode::Timeout):
+    return "Timeout";
+  case int(elp::ErrorCode::Cancelled):
+    return "Cancelled";
+  default:
+    return "Internal error";
+  }
+}
+
+static nlohmann::json makeError(nlohmann::json id, int code) {
+  return {
+      {"jsonrpc", "2.0"},
+      {"id", std::move(id)},
+      {"error", {{"code", code}, {"message", getErrorMessage(code)}}},
+  };
+}
+
+// alternatives respond with {"error": code} on failure
+static nlohmann::json makeResponse(nlohmann::json id, MethodCallResult result) {
+  if (!result.is_object() || !result.contains("error")) {
+    return {{"jsonrpc", "2.0"}, {"id", std::move(id)}, {"result", result}};
+  }
+
+  auto &error = result["error"];
+  if (error.is_object() && error.contains("code")) {
+    return {{"jsonrpc", "2.0"}, {"id", std::move(id)}, {"error", error}};
+  }
+
+  int code = kInternalError;
+  if (error.is_number_integer()) {
+    code = error.get<int>();
+    if (code == int(elp::ErrorCode::MethodNotFound)) {
+      code = kMethodNotFound;
+    } else if (code == int(elp::ErrorCode::InvalidParam)) {
+      code = kInvalidParams;
+    }
+  }
+
+  return makeError(std::move(id), code);
+}
+
+static MethodCallResult makeErrorResult(nlohmann::json error) {
+  if (error.is_object()) {
+    if (auto code = error.find("code");
+        code != error.end() && code->is_number_integer()) {
+      switch (code->get<int>()) {
+      case kMethodNotFound:
+        return {{"error", elp::ErrorCode::MethodNotFound}};
+      case kInvalidParams:
+        return {{"error", elp::ErrorCode::InvalidParam}};
+      case int(elp::ErrorCode::NotFound):
+      case int(elp::ErrorCode::Timeout):
+      case int(elp::ErrorCode::Cancelled):
+        return {{"error", *code}};
+      }
+    }
+  }
+
+  return {{"error", std::move(error)}};
+}
+
+std::string_view getEncodingName(MessageEncoding encoding) {
+  switch (encoding) {
+  case MessageEncoding::Json:
+    return "json";
+  case MessageEncoding::Cbor:
+    return "cbor";
+  case MessageEncoding::MessagePack:
+    return "msgpack";
+  }
+
+  return {};
+}
+
+std::optional<MessageEncoding> findEncoding(std::string_view name) {
+  for (auto encoding : {MessageEncoding::Json, MessageEncoding::Cbor,
+                        MessageEncoding::MessagePack}) {
+    if (getEncodingName(encoding) == name) {
+      return encoding;
+    }
+  }
+
+  return {};
+}
+
+static std::string encodeMessage(const nlohmann::json &message,
+                                 MessageEncoding encoding) {
+  std::string result;
+  switch (encoding) {
+  case MessageEncoding::Json:
+    result = message.dump();
+    break;
+  case MessageEncoding::Cbor:
+    nlohmann::json::to_cbor(message, result);
+    break;
+  case MessageEncoding::MessagePack:
+    nlohmann::json::to_msgpack(message, result);
+    break;
+  }
+  return result;
+}
+
+// discarded if bytes are not a valid message
+static nlohmann::json decodeMessage(std::span<const char> bytes,
+                                    MessageEncoding encoding) {
+  // neither cbor nor msgpack start a map or an array with these
+  auto first = std::ranges::find_if_not(bytes, [](char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  });
+  if (first == bytes.end() || *first == '{' || *first == '[') {
+    encoding = MessageEncoding::Json;
+  }
+
+  switch (encoding) {
+  case MessageEncoding::Json:
+    return nlohmann::json::parse(bytes.begin(), bytes.end(), nullptr, false);
+  case MessageEncoding::Cbor:
+    return nlohmann::json::from_cbor(bytes.begin(), bytes.end(), true, false);
+  case MessageEncoding::MessagePack:
+    return nlohmann::json::from_msgpack(bytes.begin(), bytes.end(), true,
+                                        false);
+  }
+
+  return nlohmann::json::value_t::discarded;
+}
+
+namespace {
+// responses to the requests of a batch are sent together, once the last of
+// them is answered
+struct BatchReply {
+  std::mutex mutex;
+  nlohmann::json responses = nlohmann::json::array();
+  std::size_t remaining = 0;
 };
+} // namespace
 
-std::unique_ptr<Protocol> createProtocol(std::string_view name, std::unique_ptr<Transport> transport) {
-    if (name == "ELP") {
-        return std::make_unique<ElpProtocol>(std::move(transport));
+// JSON-RPC 2.0. Messages are read by one thread and written by another, so
+// neither slow handlers nor a full pipe hold up the other direction; the
+// writer sends everything queued since its last wakeup before flushing.
+class ElpProtocol final : public Protocol {
+public:
+  using Protocol::Protocol;
+  ~ElpProtocol() override { stop(); }
+
+  void start() override;
+  void stop() override;
+  void setEncoding(MessageEncoding encoding) override { m_encoding = encoding; }
+
+  void callMethod(std::string_view name, MethodCallArgs args,
+                  std::stop_token stopToken,
+                  ResponseHandler responseHandler) override;
+  void sendNotification(std::string_view name,
+                        NotificationArgs args) override;
+
+private:
+  struct CancelCall {
+    ElpProtocol *protocol;
+    std::uint64_t id;
+
+    void operator()() const { protocol->cancel(id); }
+  };
+
+  struct PendingCall {
+    ResponseHandler responseHandler;
+    std::unique_ptr<std::stop_callback<CancelCall>> onStop;
+  };
+
+  // a call of the peer, answered once by its handler or by its cancellation
+  struct IncomingCall {
+    nlohmann::json id;
+    std::shared_ptr<BatchReply> batch;
+    std::stop_source stopSource;
+    // tells a late response of a cancelled call from a reused id
+    std::uint64_t serial = 0;
+  };
+
+  void send(nlohmann::json message);
+  void reply(const std::shared_ptr<BatchReply> &batch,
+             nlohmann::json response);
+  void runReader(std::stop_token stopToken);
+  void runWriter(std::stop_token stopToken);
+  void handleBatch(nlohmann::json messages);
+  void handleMessage(nlohmann::json message,
+                     const std::shared_ptr<BatchReply> &batch);
+  void handleResponse(nlohmann::json message);
+  void cancel(std::uint64_t id);
+  void cancelIncoming(const nlohmann::json &params);
+  std::optional<IncomingCall> takeIncoming(const std::string &key,
+                                           std::uint64_t serial);
+  void failPendingCalls();
+
+  std::mutex m_mutex;
+  std::uint64_t m_nextId = 1;
+  std::unordered_map<std::uint64_t, PendingCall> m_pending;
+  // calls of the peer by serialized id
+  std::unordered_map<std::string, IncomingCall> m_incoming;
+  std::uint64_t m_incomingSerial = 0;
+  bool m_closed = false;
+
+  std::atomic<MessageEncoding> m_encoding = MessageEncoding::Json;
+
+  std::mutex m_writeMutex;
+  std::condition_variable_any m_writeCv;
+  std::vector<std::string> m_outgoing;
+  // set once the transport failed, later messages are dropped
+  bool m_sendFailed = false;
+
+  std::jthread m_writer;
+  std::jthread m_reader;
+};
+
+void ElpProtocol::start() {
+  m_writer = std::jthread(
+      [this](std::stop_token stopToken) { runWriter(std::move(stopToken)); });
+  m_reader = std::jthread(
+      [this](std::stop_token stopToken) { runReader(std::move(stopToken)); });
+}
+
+void ElpProtocol::stop() {
+  // the writer sends what is queued before it exits
+  if (m_writer.joinable()) {
+    m_writer.request_stop();
+    m_writer.join();
+  }
+
+  if (m_reader.joinable()) {
+    m_reader.request_stop();
+    transport()->close();
+    m_reader.join();
+  }
+
+  failPendingCalls();
+}
+
+void ElpProtocol::callMethod(std::string_view name, MethodCallArgs args,
+                             std::stop_token stopToken,
+                             ResponseHandler responseHandler) {
+  if (stopToken.stop_requested()) {
+    responseHandler({{"error", elp::ErrorCode::Cancelled}});
+    return;
+  }
+
+  std::uint64_t id;
+  {
+    std::unique_lock lock(m_mutex);
+    if (m_closed) {
+      lock.unlock();
+      responseHandler({{"error", elp::ErrorCode::Cancelled}});
+      return;
+    }
+
+    id = m_nextId++;
+    m_pending.emplace(id, PendingCall{std::move(responseHandler)});
+  }
+
+  send({
+      {"jsonrpc", "2.0"},
+      {"id", id},
+      {"method", name},
+      {"params", std::move(args)},
+  });
+
+  if (!stopToken.stop_possible()) {
+    return;
+  }
+
+  // runs right away if a stop was requested in the meantime, so it is
+  // created without holding the lock
+  auto onStop = std::make_unique<std::stop_callback<CancelCall>>(
+      std::move(stopToken), CancelCall{this, id});
+
+  {
+    std::lock_guard lock(m_mutex);
+    if (auto it = m_pending.find(id); it != m_pending.end()) {
+      it->second.onStop = std::move(onStop);
+    }
+  }
+
+  // destroyed here if the call ended already, which waits for a running
+  // callback and so must not hold the lock
+}
+
+void ElpProtocol::sendNotification(std::string_view name,
+                                   NotificationArgs args) {
+  send({{"jsonrpc", "2.0"}, {"method", name}, {"params", std::move(args)}});
+}
+
+void ElpProtocol::send(nlohmann::json message) {
+  auto bytes = encodeMessage(message, m_encoding);
+
+  {
+    std::lock_guard lock(m_writeMutex);
+    if (m_sendFailed) {
+      return;
+    }
+    m_outgoing.push_back(std::move(bytes));
+  }
+  m_writeCv.notify_one();
+}
+
+void ElpProtocol::reply(const std::shared_ptr<BatchReply> &batch,
+                        nlohmann::json response) {
+  if (batch == nullptr) {
+    if (!response.is_null()) {
+      send(std::move(response));
     }
+    return;
+  }
+
+  nlohmann::json responses;
+  {
+    std::lock_guard lock(batch->mutex);
+    if (!response.is_null()) {
+      batch->responses.push_back(std::move(response));
+    }
+
+    if (--batch->remaining != 0) {
+      return;
+    }
+    responses = std::move(batch->responses);
+  }
+
+  // a batch of notifications gets no response at all
+  if (!responses.empty()) {
+    send(std::move(responses));
+  }
+}
+
+void ElpProtocol::runReader(std::stop_token stopToken) {
+  while (!stopToken.stop_requested()) {
+    std::span<char> bytes;
+    if (auto error = transport()->receive(bytes); error != std::errc{}) {
+      if (error != std::errc::broken_pipe) {
+        std::fprintf(stderr, "ELP: failed to receive message: %s\n",
+                     std::make_error_code(error).message().c_str());
+      }
+      break;
+    }
+
+    auto message = decodeMessage(bytes, m_encoding);
+    if (message.is_discarded()) {
+      send(makeError(nullptr, kParseError));
+    } else if (message.is_array()) {
+      handleBatch(std::move(message));
+    } else {
+      handleMessage(std::move(message), nullptr);
+    }
+  }
+
+  failPendingCalls();
+}
+
+void ElpProtocol::runWriter(std::stop_token stopToken) {
+  std::unique_lock lock(m_writeMutex);
+
+  while (true) {
+    m_writeCv.wait(lock, stopToken, [&] { return !m_outgoing.empty(); });
+    if (m_outgoing.empty()) {
+      // stopped with nothing left to send
+      return;
+    }
+
+    auto messages = std::exchange(m_outgoing, {});
+    lock.unlock();
+
+    for (auto &message : messages) {
+      if (auto error = transport()->sendMessage(message);
+          error != std::errc{}) {
+        std::fprintf(stderr, "ELP: failed to send message: %s\n",
+                     std::make_error_code(error).message().c_str());
+
+        // the requests among the dropped messages would never be answered,
+        // so the protocol is closed and its calls fail instead
+        lock.lock();
+        m_sendFailed = true;
+        m_outgoing.clear();
+        lock.unlock();
+
+        transport()->close();
+        failPendingCalls();
+        return;
+      }
+    }
+
+    transport()->flush();
+    lock.lock();
+  }
+}
+
+void ElpProtocol::handleBatch(nlohmann::json messages) {
+  if (messages.empty()) {
+    send(makeError(nullptr, kInvalidRequest));
+    return;
+  }
+
+  auto batch = std::make_shared<BatchReply>();
+  // every message replies once, possibly with nothing, and the extra count
+  // keeps the batch from completing before all of them are dispatched
+  batch->remaining = messages.size() + 1;
+
+  for (auto &message : messages) {
+    handleMessage(std::move(message), batch);
+  }
+
+  reply(batch, nullptr);
+}
+
+void ElpProtocol::handleMessage(nlohmann::json message,
+                                const std::shared_ptr<BatchReply> &batch) {
+  if (!message.is_object()) {
+    reply(batch, makeError(nullptr, kInvalidRequest));
+    return;
+  }
+
+  auto id = message.find("id");
+  auto method = message.find("method");
+  if (method == message.end()) {
+    if (id != message.end()) {
+      handleResponse(std::move(message));
+    }
+    reply(batch, nullptr);
+    return;
+  }
+
+  if (!method->is_string()) {
+    reply(batch, id == message.end()
+                     ? nlohmann::json()
+                     : makeError(std::move(*id), kInvalidRequest));
+    return;
+  }
+
+  auto name = method->get<std::string>();
+  MethodCallArgs params;
+  if (auto it = message.find("params"); it != message.end()) {
+    params = std::move(*it);
+  }
+
+  if (id == message.end()) {
+    if (name == kCancelRequest) {
+      cancelIncoming(params);
+    } else if (m_notificationHandler) {
+      m_notificationHandler(name, std::move(params));
+    }
+    reply(batch, nullptr);
+    return;
+  }
+
+  if (!m_methodHandler) {
+    reply(batch, makeError(std::move(*id), kMethodNotFound));
+    return;
+  }
+
+  auto key = id->dump();
+  std::stop_token stopToken;
+  std::uint64_t serial;
+  {
+    std::unique_lock lock(m_mutex);
+    auto [it, inserted] = m_incoming.try_emplace(key);
+    if (!inserted) {
+      lock.unlock();
+      // the id of a call still in flight
+      reply(batch, makeError(std::move(*id), kInvalidRequest));
+      return;
+    }
+
+    serial = ++m_incomingSerial;
+    it->second.id = std::move(*id);
+    it->second.batch = batch;
+    it->second.serial = serial;
+    stopToken = it->second.stopSource.get_token();
+  }
+
+  m_methodHandler(
+      name, std::move(params), std::move(stopToken),
+      [this, key = std::move(key), serial](MethodCallResult result) {
+        // already answered if the peer cancelled the call
+        if (auto call = takeIncoming(key, serial)) {
+          reply(call->batch,
+                makeResponse(std::move(call->id), std::move(result)));
+        }
+      });
+}
+
+std::optional<ElpProtocol::IncomingCall>
+ElpProtocol::takeIncoming(const std::string &key, std::uint64_t serial) {
+  std::lock_guard lock(m_mutex);
+  auto it = m_incoming.find(key);
+  if (it == m_incoming.end() || it->second.serial != serial) {
+    return {};
+  }
+
+  auto call = std::move(it->second);
+  m_incoming.erase(it);
+  return call;
+}
+
+void ElpProtocol::handleResponse(nlohmann::json message) {
+  auto &id = message["id"];
+  if (!id.is_number_unsigned()) {
+    return;
+  }
+
+  PendingCall call;
+  {
+    std::lock_guard lock(m_mutex);
+    auto it = m_pending.find(id.get<std::uint64_t>());
+    if (it == m_pending.end()) {
+      // cancelled or unknown
+      return;
+    }
+
+    call = std::move(it->second);
+    m_pending.erase(it);
+  }
+
+  if (auto error = message.find("error"); error != message.end()) {
+    call.responseHandler(makeErrorResult(std::move(*error)));
+  } else if (auto result = message.find("result"); result != message.end()) {
+    call.responseHandler(std::move(*result));
+  } else {
+    call.responseHandler(makeErrorResult(nullptr));
+  }
+}
+
+void ElpProtocol::cancel(std::uint64_t id) {
+  PendingCall call;
+  {
+    std::lock_guard lock(m_mutex);
+    auto it = m_pending.find(id);
+    if (it == m_pending.end()) {
+      return;
+    }
+
+    call = std::move(it->second);
+    m_pending.erase(it);
+  }
+
+  sendNotification(kCancelRequest, {{"id", id}});
+  call.responseHandler({{"error", elp::ErrorCode::Cancelled}});
+}
+
+void ElpProtocol::cancelIncoming(const nlohmann::json &params) {
+  if (!params.is_object() || !params.contains("id")) {
+    return;
+  }
+
+  IncomingCall call;
+  {
+    std::lock_guard lock(m_mutex);
+    auto it = m_incoming.find(params["id"].dump());
+    if (it == m_incoming.end()) {
+      return;
+    }
+
+    call = std::move(it->second);
+    m_incoming.erase(it);
+  }
+
+  // answered right away, the handler may never respond to a stopped call
+  call.stopSource.request_stop();
+  reply(call.batch,
+        makeError(std::move(call.id), int(elp::ErrorCode::Cancelled)));
+}
+
+void ElpProtocol::failPendingCalls() {
+  std::unordered_map<std::uint64_t, PendingCall> pending;
+  std::unordered_map<std::string, IncomingCall> incoming;
+  {
+    std::lock_guard lock(m_mutex);
+    m_closed = true;
+    pending = std::exchange(m_pending, {});
+    incoming = std::exchange(m_incoming, {});
+  }
+
+  for (auto &[key, call] : incoming) {
+    call.stopSource.request_stop();
+  }
+
+  for (auto &[id, call] : pending) {
+    call.responseHandler({{"error", elp::ErrorCode::Cancelled}});
+  }
+}
+
+std::unique_ptr<Protocol> createProtocol(std::string_view name, std::unique_ptr<Transport> transport) {
+  if (name == "ELP") {
+    return std::make_unique<ElpProtocol>(std::move(transport));
+  }
 
-    return nullptr;
+  return nullptr;
 }
@@ -1,14 +1,77 @@
 #pragma once
+#include "Alternative.hpp"
 #include "Transport.hpp"
+
+#include <functional>
 #include <memory>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+
+enum class MessageEncoding {
+  Json,
+  Cbor,
+  MessagePack,
+};
 
+// names used by InitializeRequest::encodings
+std::string_view getEncodingName(MessageEncoding encoding);
+std::optional<MessageEncoding> findEncoding(std::string_view name);
+
+// A connection to an out of process alternative. Both sides call methods and
+// send notifications; calls are pipelined, any number of them can be in
+// flight and responses arrive in the order they complete.
 class Protocol {
 public:
+  // called once with the result or an error object, from any thread
+  using ResponseHandler = std::move_only_function<void(MethodCallResult)>;
+  // handles a call of the peer, stopToken is requested when the peer cancels
+  // it. response must not be called after the protocol is destroyed
+  using MethodHandler = std::move_only_function<void(
+      std::string_view name, MethodCallArgs args, std::stop_token stopToken,
+      ResponseHandler response)>;
+  using NotificationHandler =
+      std::move_only_function<void(std::string_view name,
+                                   NotificationArgs args)>;
+
   virtual ~Protocol() = default;
   Protocol(std::unique_ptr<Transport> t) : pTransport(std::move(t)) {}
 
-//   void setMethodHandler(std::string method, std::function<void(const VariantValue &value)>) {}
-//   void setNotificationHandler() {}
+  // handlers run on the thread that reads the transport, they must not block
+  // it. set them before start
+  void setMethodHandler(MethodHandler handler) {
+    m_methodHandler = std::move(handler);
+  }
+  void setNotificationHandler(NotificationHandler handler) {
+    m_notificationHandler = std::move(handler);
+  }
+
+  virtual void start() = 0;
+
+  // encoding of the messages sent from now on. json text is recognized by
+  // its first byte and always accepted, anything else is decoded with the
+  // current encoding. a peer may send binary messages right after it agreed,
+  // so switch from the response handler that receives its answer, it runs on
+  // the reader before the next message is decoded
+  virtual void setEncoding(MessageEncoding encoding) = 0;
+
+  // sends queued messages and closes the transport, returns once it stopped
+  // receiving. calls still in flight fail with ErrorCode::Cancelled
+  virtual void stop() = 0;
+
+  // requesting stopToken cancels the call on the peer and resolves it with
+  // ErrorCode::Cancelled
+  virtual void callMethod(std::string_view name, MethodCallArgs args,
+                          std::stop_token stopToken,
+                          ResponseHandler responseHandler) = 0;
+  virtual void sendNotification(std::string_view name,
+                                NotificationArgs args) = 0;
+
+protected:
+  Transport *transport() { return pTransport.get(); }
+
+  MethodHandler m_methodHandler;
+  NotificationHandler m_notificationHandler;
 
 private:
   std::unique_ptr<Transport> pTransport;
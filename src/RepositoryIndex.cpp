@@ -0,0 +1,126 @@
+#include "RepositoryIndex.hpp"
+#include "BinaryStream.hpp"
+#include "PackageIndex.hpp"
+
+#include <cstdio>
+#include <filesystem>
+
+// Layout, see BinaryStream.hpp for the encoding:
+//
+//   char     magic[4] = "ELPR"
+//   u32      version
+//   u8       compression, see Compression
+//   u64      payload size
+//   payload, compressed {
+//     u32 entry count, entry[] { string path, manifest }
+//     u32 thumbnail count, thumbnail[] { string key, string bytes }
+//   }
+
+static constexpr char kMagic[4] = {'E', 'L', 'P', 'R'};
+
+// rejects indexes that would take unreasonable memory to decompress
+static constexpr std::uint64_t kMaxPayloadSize = 1024 * 1024 * 1024;
+
+std::string RepositoryIndex::thumbnailKey(std::string_view entryPath,
+                                          std::string_view icon) {
+  return (std::filesystem::path(entryPath) / icon)
+      .lexically_normal()
+      .generic_string();
+}
+
+std::optional<RepositoryIndex>
+RepositoryIndex::parse(std::string_view bytes) {
+  try {
+    BinaryReader reader{{bytes.data(), bytes.size()}};
+    if (!reader.readMagic(kMagic) ||
+        reader.read<std::uint32_t>() != kVersion) {
+      std::fprintf(stderr, "unsupported repository index\n");
+      return {};
+    }
+
+    auto compression = reader.read<std::uint8_t>();
+    auto payloadSize = reader.read<std::uint64_t>();
+    if (compression > static_cast<std::uint8_t>(Compression::Zstd) ||
+        payloadSize > kMaxPayloadSize) {
+      std::fprintf(stderr, "invalid repository index header\n");
+      return {};
+    }
+
+    std::string payload;
+    payload.reserve(payloadSize);
+    auto decompressor = Decompressor::create(
+        static_cast<Compression>(compression),
+        [&](std::span<const char> chunk) -> std::error_code {
+          if (payload.size() + chunk.size() > payloadSize) {
+            return std::make_error_code(std::errc::illegal_byte_sequence);
+          }
+          payload.append(chunk.data(), chunk.size());
+          return {};
+        });
+
+    if (decompressor == nullptr) {
+      std::fprintf(stderr, "repository index compression is not supported\n");
+      return {};
+    }
+
+    auto ec = decompressor->write(reader.data);
+    if (!ec) {
+      ec = decompressor->finish();
+    }
+    if (ec || payload.size() != payloadSize) {
+      std::fprintf(stderr, "failed to decompress repository index\n");
+      return {};
+    }
+
+    BinaryReader payloadReader{{payload.data(), payload.size()}};
+    RepositoryIndex result;
+
+    auto entryCount = payloadReader.read<std::uint32_t>();
+    result.entries.reserve(entryCount);
+    for (std::uint32_t i = 0; i < entryCount; ++i) {
+      auto &entry = result.entries.emplace_back();
+      entry.path = payloadReader.readString();
+      entry.manifest = PackageIndex::decodeManifest(payloadReader);
+    }
+
+    auto thumbnailCount = payloadReader.read<std::uint32_t>();
+    for (std::uint32_t i = 0; i < thumbnailCount; ++i) {
+      auto key = payloadReader.readString();
+      result.thumbnails.emplace(std::move(key), payloadReader.readString());
+    }
+
+    return result;
+  } catch (const std::exception &ex) {
+    std::fprintf(stderr, "failed to parse repository index: %s\n", ex.what());
+    return {};
+  }
+}
+
+std::string RepositoryIndex::encodePayload() const {
+  std::string result;
+  BinaryWriter writer{result};
+
+  writer.write(static_cast<std::uint32_t>(entries.size()));
+  for (auto &entry : entries) {
+    writer.write(entry.path);
+    PackageIndex::encodeManifest(writer, entry.manifest);
+  }
+
+  writer.write(static_cast<std::uint32_t>(thumbnails.size()));
+  for (auto &[key, bytes] : thumbnails) {
+    writer.write(key);
+    writer.write(bytes);
+  }
+
+  return result;
+}
+
+std::string RepositoryIndex::encodeHeader(Compression compression,
+                                          std::uint64_t payloadSize) {
+  std::string result(kMagic, sizeof(kMagic));
+  BinaryWriter writer{result};
+  writer.write(kVersion);
+  writer.write(static_cast<std::uint8_t>(compression));
+  writer.write(payloadSize);
+  return result;
+}
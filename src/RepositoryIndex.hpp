@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Decompressor.hpp"
+#include "Manifest.hpp"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// All manifests of a package source in a single compressed file, built by
+// the repository-index tool. Fetched and decompressed in one pass instead of
+// a request per manifest and icon.
+struct RepositoryIndex {
+  static constexpr std::uint32_t kVersion = 2;
+  static constexpr std::string_view kExtension = ".elpr";
+
+  struct Entry {
+    // directory of the manifest relative to the index, "." for the index
+    // directory itself
+    std::string path;
+    Manifest manifest;
+  };
+
+  std::vector<Entry> entries;
+
+  // icons by path relative to the index, see thumbnailKey
+  std::map<std::string, std::string, std::less<>> thumbnails;
+
+  static std::string thumbnailKey(std::string_view entryPath,
+                                  std::string_view icon);
+
+  static std::optional<RepositoryIndex> parse(std::string_view bytes);
+
+  // uncompressed content, the tool compresses it and prepends the header
+  std::string encodePayload() const;
+  static std::string encodeHeader(Compression compression,
+                                  std::uint64_t payloadSize);
+};
@@ -0,0 +1,523 @@
+#include "SegmentedDownload.hpp"
+
+#include <QCoreApplication>
+#include <QNetworkReply>
+#include <QtConcurrent>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// Files smaller than two segments are fetched with a single request
+static constexpr std::uint64_t kMinSegmentSize = 4 * 1024 * 1024;
+static constexpr std::size_t kMaxSegments = 4;
+static constexpr int kMaxRetries = 3;
+
+// Downloaded bytes between two writes of the state file
+static constexpr std::uint64_t kStateSaveInterval = 4 * 1024 * 1024;
+
+// Downloaded bytes between two progress reports
+static constexpr std::uint64_t kProgressInterval = 1024 * 1024;
+
+// Bytes read back for the hash per received chunk, keeps the UI responsive
+static constexpr std::uint64_t kHashStep = 4 * 1024 * 1024;
+
+QFuture<bool> SegmentedDownload::start(QUrl url, std::filesystem::path target,
+                                       ProgressFn onProgress,
+                                       NetworkPriority priority,
+                                       std::string_view hash) {
+  auto download = std::make_shared<SegmentedDownload>(
+      std::move(url), std::move(target), std::move(onProgress), priority);
+  auto future = download->m_promise.future();
+  download->m_promise.start();
+
+  if (!hash.empty()) {
+    download->m_hash = ContentHash::create(hash);
+    if (download->m_hash == nullptr) {
+      download->m_promise.addResult(false);
+      download->m_promise.finish();
+      return future;
+    }
+  }
+
+  download->probe();
+  return future;
+}
+
+SegmentedDownload::SegmentedDownload(QUrl url, std::filesystem::path target,
+                                     ProgressFn onProgress,
+                                     NetworkPriority priority)
+    : m_url(std::move(url)), m_target(std::move(target)),
+      m_onProgress(std::move(onProgress)), m_priority(priority) {
+  m_partPath = m_target;
+  m_partPath += ".part";
+  m_statePath = m_target;
+  m_statePath += ".state";
+}
+
+void SegmentedDownload::probe() {
+  NetworkScheduler::instance().head(
+      QNetworkRequest(m_url), m_priority,
+      {
+          .onFinished =
+              [self = shared_from_this()](QNetworkReply *reply) {
+                if (reply->error() != QNetworkReply::NoError) {
+                  // some servers reject HEAD, fall back to a single request
+                  self->begin(0, false, {}, {});
+                  return;
+                }
+
+                auto size =
+                    reply->header(QNetworkRequest::ContentLengthHeader)
+                        .toULongLong();
+                auto acceptRanges =
+                    reply->rawHeader("Accept-Ranges").trimmed().toLower() ==
+                    "bytes";
+
+                self->begin(size, acceptRanges,
+                            reply->rawHeader("ETag").toStdString(),
+                            reply->rawHeader("Last-Modified").toStdString());
+              },
+      });
+}
+
+void SegmentedDownload::begin(std::uint64_t size, bool acceptRanges,
+                              std::string etag, std::string lastModified) {
+  m_size = size;
+  m_acceptRanges = acceptRanges && size != 0;
+  m_etag = std::move(etag);
+  m_lastModified = std::move(lastModified);
+
+  std::error_code ec;
+  std::filesystem::create_directories(m_target.parent_path(), ec);
+
+  auto resumed = m_acceptRanges && loadState();
+  if (!resumed) {
+    std::filesystem::remove(m_statePath, ec);
+    resetSegments();
+  }
+
+  m_file.setFileName(QString::fromUtf8(m_partPath.string()));
+  auto mode = resumed ? QFile::ReadWrite : QFile::ReadWrite | QFile::Truncate;
+  if (!m_file.open(mode)) {
+    std::fprintf(stderr, "failed to open '%s'\n", m_partPath.string().c_str());
+    finish(false);
+    return;
+  }
+
+  if (!resumed && m_acceptRanges) {
+    // segments write at their own offsets
+    m_file.resize(static_cast<qint64>(m_size));
+    saveState();
+  }
+
+  for (auto &segment : m_segments) {
+    m_downloaded += segment.done;
+  }
+
+  if (std::all_of(m_segments.begin(), m_segments.end(),
+                  [](const Segment &segment) { return segment.complete(); })) {
+    finish(true);
+    return;
+  }
+
+  for (std::size_t i = 0; i < m_segments.size(); ++i) {
+    if (!m_segments[i].complete()) {
+      startSegment(i);
+    }
+  }
+}
+
+void SegmentedDownload::resetSegments() {
+  m_segments.clear();
+  m_downloaded = 0;
+
+  if (!m_acceptRanges) {
+    m_segments.push_back({.end = m_size});
+    return;
+  }
+
+  auto count = std::clamp<std::uint64_t>(m_size / kMinSegmentSize, 1,
+                                         kMaxSegments);
+  auto step = m_size / count;
+
+  for (std::uint64_t i = 0; i < count; ++i) {
+    m_segments.push_back({
+        .begin = i * step,
+        .end = i + 1 == count ? m_size : (i + 1) * step,
+    });
+  }
+}
+
+bool SegmentedDownload::loadState() {
+  std::ifstream input(m_statePath);
+  if (!input) {
+    return false;
+  }
+
+  auto state = nlohmann::json::parse(input, nullptr, false);
+  if (!state.is_object() || !state.contains("segments")) {
+    return false;
+  }
+
+  if (state.value("url", "") != m_url.toString().toStdString() ||
+      state.value("size", std::uint64_t{0}) != m_size ||
+      state.value("etag", "") != m_etag ||
+      state.value("lastModified", "") != m_lastModified) {
+    // the remote file changed
+    return false;
+  }
+
+  std::error_code ec;
+  if (std::filesystem::file_size(m_partPath, ec) != m_size || ec) {
+    return false;
+  }
+
+  m_segments.clear();
+  for (auto &segment : state["segments"]) {
+    Segment loaded{
+        .begin = segment.value("begin", std::uint64_t{0}),
+        .end = segment.value("end", std::uint64_t{0}),
+        .done = segment.value("done", std::uint64_t{0}),
+    };
+
+    if (loaded.end > m_size || loaded.begin + loaded.done > loaded.end) {
+      return false;
+    }
+    m_segments.push_back(loaded);
+  }
+
+  return !m_segments.empty();
+}
+
+void SegmentedDownload::saveState() {
+  if (!m_acceptRanges) {
+    // a plain request cannot be resumed
+    return;
+  }
+
+  // the state must not claim bytes that are still buffered
+  m_file.flush();
+
+  auto segments = nlohmann::json::array();
+  for (auto &segment : m_segments) {
+    segments.push_back({
+        {"begin", segment.begin},
+        {"end", segment.end},
+        {"done", segment.done},
+    });
+  }
+
+  nlohmann::json state{
+      {"url", m_url.toString().toStdString()},
+      {"size", m_size},
+      {"etag", m_etag},
+      {"lastModified", m_lastModified},
+      {"segments", std::move(segments)},
+  };
+
+  auto tmpPath = m_statePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream output(tmpPath);
+    output << state.dump();
+    if (!output) {
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, m_statePath, ec);
+  m_unsavedBytes = 0;
+}
+
+void SegmentedDownload::startSegment(std::size_t index) {
+  auto &segment = m_segments[index];
+
+  QNetworkRequest request(m_url);
+  if (m_acceptRanges) {
+    auto range = "bytes=" + std::to_string(segment.begin + segment.done) +
+                 "-" + std::to_string(segment.end - 1);
+    request.setRawHeader("Range", QByteArray::fromStdString(range));
+
+    if (!m_etag.empty()) {
+      // get the whole file instead of a range of a changed one
+      request.setRawHeader("If-Range", QByteArray::fromStdString(m_etag));
+    }
+  }
+
+  auto attempt = ++m_attempts;
+  segment.attempt = attempt;
+  segment.task = NetworkScheduler::instance().get(
+      std::move(request), m_priority,
+      {
+          .onData =
+              [self = shared_from_this(), index,
+               attempt](QNetworkReply *reply, QByteArray bytes) {
+                if (self->isCurrent(index, attempt)) {
+                  self->receive(reply, index, std::move(bytes));
+                }
+              },
+          .onFinished =
+              [self = shared_from_this(), index,
+               attempt](QNetworkReply *reply) {
+                if (self->isCurrent(index, attempt)) {
+                  self->segmentFinished(reply, index);
+                }
+              },
+      });
+}
+
+bool SegmentedDownload::isCurrent(std::size_t index,
+                                  std::uint64_t attempt) const {
+  return !m_finished && index < m_segments.size() &&
+         m_segments[index].attempt == attempt;
+}
+
+void SegmentedDownload::receive(QNetworkReply *reply, std::size_t index,
+                                QByteArray bytes) {
+  if (m_acceptRanges &&
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+          200) {
+    // the server ignored the range or the file changed since the state was
+    // saved
+    restartPlain();
+    return;
+  }
+
+  auto &segment = m_segments[index];
+  auto size = static_cast<std::uint64_t>(bytes.size());
+  auto offset = segment.begin + segment.done;
+
+  if (segment.end != 0) {
+    size = std::min(size, segment.end - segment.begin - segment.done);
+  }
+
+  if (size == 0) {
+    return;
+  }
+
+  if (!m_file.seek(static_cast<qint64>(offset)) ||
+      m_file.write(bytes.data(), static_cast<qint64>(size)) !=
+          static_cast<qint64>(size)) {
+    std::fprintf(stderr, "failed to write '%s'\n", m_partPath.string().c_str());
+    finish(false);
+    return;
+  }
+
+  segment.done += size;
+  m_downloaded += size;
+  m_unsavedBytes += size;
+
+  if (m_hash) {
+    if (offset == m_hashed) {
+      m_hash->update(std::span(bytes.data(), size));
+      m_hashed += size;
+    }
+
+    if (!advanceHash(kHashStep)) {
+      finish(false);
+      return;
+    }
+  }
+
+  if (m_unsavedBytes >= kStateSaveInterval) {
+    saveState();
+  }
+
+  if (m_onProgress && m_downloaded - m_reported >= kProgressInterval) {
+    m_reported = m_downloaded;
+    m_onProgress(m_downloaded, m_size);
+  }
+}
+
+void SegmentedDownload::segmentFinished(QNetworkReply *reply,
+                                        std::size_t index) {
+  auto &segment = m_segments[index];
+  segment.attempt = 0;
+  segment.task = nullptr;
+
+  auto success = reply->error() == QNetworkReply::NoError &&
+                 (segment.end == 0 || segment.complete());
+
+  if (!success) {
+    if (m_acceptRanges && ++segment.retries <= kMaxRetries) {
+      // continues after the bytes already written
+      saveState();
+      startSegment(index);
+      return;
+    }
+
+    std::fprintf(stderr, "download of '%s' failed: %s\n",
+                 m_url.toString().toStdString().c_str(),
+                 reply->errorString().toStdString().c_str());
+    finish(false);
+    return;
+  }
+
+  if (segment.end == 0) {
+    // size was not known in advance
+    segment.end = segment.begin + segment.done;
+  }
+
+  if (std::all_of(m_segments.begin(), m_segments.end(),
+                  [](const Segment &segment) { return segment.complete(); })) {
+    finish(true);
+  }
+}
+
+void SegmentedDownload::abortSegments() {
+  for (auto &segment : m_segments) {
+    segment.attempt = 0;
+    if (auto task = std::exchange(segment.task, nullptr)) {
+      task->abort();
+    }
+  }
+}
+
+bool SegmentedDownload::advanceHash(std::uint64_t budget) {
+  QByteArray buffer;
+
+  for (auto &segment : m_segments) {
+    if (segment.begin > m_hashed ||
+        (segment.end != 0 && segment.end <= m_hashed)) {
+      continue;
+    }
+
+    auto available = segment.begin + segment.done;
+    while (m_hashed < available && budget > 0) {
+      auto size = std::min({available - m_hashed, budget, kHashStep});
+      buffer.resize(static_cast<qsizetype>(size));
+
+      if (!m_file.seek(static_cast<qint64>(m_hashed)) ||
+          m_file.read(buffer.data(), buffer.size()) != buffer.size()) {
+        std::fprintf(stderr, "failed to read '%s'\n",
+                     m_partPath.string().c_str());
+        return false;
+      }
+
+      m_hash->update(std::span(buffer.data(), buffer.size()));
+      m_hashed += size;
+      budget -= size;
+    }
+
+    if (m_hashed != segment.end) {
+      // the segment is still downloading
+      break;
+    }
+  }
+
+  return true;
+}
+
+void SegmentedDownload::restartPlain() {
+  std::fprintf(stderr, "'%s' does not support ranges, restarting download\n",
+               m_url.toString().toStdString().c_str());
+
+  abortSegments();
+
+  std::error_code ec;
+  std::filesystem::remove(m_statePath, ec);
+
+  m_acceptRanges = false;
+  resetSegments();
+  m_file.resize(0);
+
+  if (m_hash) {
+    m_hash->reset();
+    m_hashed = 0;
+  }
+  startSegment(0);
+}
+
+// Hashes the bytes in [begin, end) of a file that is no longer written
+static bool hashFileRange(const std::filesystem::path &path,
+                          ContentHash &hash, std::uint64_t begin,
+                          std::uint64_t end) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.seekg(static_cast<std::streamoff>(begin))) {
+    return false;
+  }
+
+  std::vector<char> buffer(kHashStep);
+  while (begin < end) {
+    auto size = std::min<std::uint64_t>(end - begin, buffer.size());
+    if (!input.read(buffer.data(), static_cast<std::streamsize>(size))) {
+      return false;
+    }
+
+    hash.update(std::span(buffer.data(), size));
+    begin += size;
+  }
+
+  return true;
+}
+
+void SegmentedDownload::finish(bool success) {
+  if (std::exchange(m_finished, true)) {
+    return;
+  }
+
+  abortSegments();
+
+  if (!success || !m_hash) {
+    complete(success);
+    return;
+  }
+
+  // most of a resumed download may still have to be read back, which must
+  // not block the UI thread. nothing else touches the file or the hash once
+  // the download finished
+  m_file.close();
+  QtConcurrent::run([path = m_partPath,
+                     hash = std::shared_ptr<ContentHash>(std::move(m_hash)),
+                     begin = m_hashed, end = m_downloaded] {
+    return hashFileRange(path, *hash, begin, end) && hash->verify();
+  }).then(QCoreApplication::instance(),
+          [self = shared_from_this()](bool matches) {
+            if (matches) {
+              self->complete(true);
+              return;
+            }
+
+            std::fprintf(stderr,
+                         "downloaded file '%s' does not match its hash\n",
+                         self->m_url.toString().toStdString().c_str());
+
+            // a resume would produce the same content
+            std::error_code ec;
+            std::filesystem::remove(self->m_partPath, ec);
+            std::filesystem::remove(self->m_statePath, ec);
+            self->m_promise.addResult(false);
+            self->m_promise.finish();
+          });
+}
+
+void SegmentedDownload::complete(bool success) {
+  if (success) {
+    m_file.close();
+
+    std::error_code ec;
+    std::filesystem::rename(m_partPath, m_target, ec);
+    if (ec) {
+      std::fprintf(stderr, "failed to move download to '%s': %s\n",
+                   m_target.string().c_str(), ec.message().c_str());
+      success = false;
+    } else {
+      std::filesystem::remove(m_statePath, ec);
+    }
+  } else {
+    // keep the part and the state, the next attempt resumes
+    saveState();
+    m_file.close();
+  }
+
+  if (success && m_onProgress) {
+    m_onProgress(m_downloaded, m_size == 0 ? m_downloaded : m_size);
+  }
+
+  m_promise.addResult(success);
+  m_promise.finish();
+}
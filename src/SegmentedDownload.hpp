@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ContentHash.hpp"
+#include "NetworkScheduler.hpp"
+
+#include <QFile>
+#include <QFuture>
+#include <QPromise>
+#include <QUrl>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class QNetworkReply;
+
+// Downloads a file with concurrent HTTP range requests, written straight to
+// their offsets of a preallocated file. Completed ranges are persisted next
+// to the target after every few megabytes, so starting the same download
+// again resumes where it was interrupted. Servers without range support get a
+// single plain request. An expected hash is computed while the data arrives:
+// bytes that continue the hashed prefix of the file are hashed directly,
+// segments further ahead are read back once the prefix reaches them, what a
+// resumed download still lacks is read back on a worker once it completes.
+//
+// Lives on the UI thread, like the network access manager.
+class SegmentedDownload
+    : public std::enable_shared_from_this<SegmentedDownload> {
+public:
+  using ProgressFn = std::move_only_function<void(std::uint64_t downloaded,
+                                                  std::uint64_t total)>;
+
+  // resolves to true once target is complete and matches hash, if set
+  static QFuture<bool>
+  start(QUrl url, std::filesystem::path target, ProgressFn onProgress = nullptr,
+        NetworkPriority priority = NetworkPriority::Interactive,
+        std::string_view hash = {});
+
+  SegmentedDownload(QUrl url, std::filesystem::path target,
+                    ProgressFn onProgress, NetworkPriority priority);
+
+private:
+  struct Segment {
+    std::uint64_t begin = 0;
+    // 0 if the size is unknown
+    std::uint64_t end = 0;
+    std::uint64_t done = 0;
+    int retries = 0;
+    // identifies the request of the segment, 0 if none is running
+    std::uint64_t attempt = 0;
+    std::shared_ptr<NetworkTask> task;
+
+    bool complete() const { return end != 0 && begin + done == end; }
+  };
+
+  void probe();
+  void begin(std::uint64_t size, bool acceptRanges, std::string etag,
+             std::string lastModified);
+  void resetSegments();
+  bool loadState();
+  void saveState();
+  void startSegment(std::size_t index);
+  // replies of aborted or restarted segments are ignored
+  bool isCurrent(std::size_t index, std::uint64_t attempt) const;
+  void receive(QNetworkReply *reply, std::size_t index, QByteArray bytes);
+  void segmentFinished(QNetworkReply *reply, std::size_t index);
+  void abortSegments();
+  // hashes up to budget bytes that were written after the hashed prefix
+  bool advanceHash(std::uint64_t budget);
+  void restartPlain();
+  // stops the requests, verifies the hash and then completes
+  void finish(bool success);
+  void complete(bool success);
+
+  QUrl m_url;
+  std::filesystem::path m_target;
+  std::filesystem::path m_partPath;
+  std::filesystem::path m_statePath;
+  ProgressFn m_onProgress;
+  NetworkPriority m_priority;
+  QPromise<bool> m_promise;
+  QFile m_file;
+
+  std::uint64_t m_size = 0;
+  bool m_acceptRanges = false;
+  std::string m_etag;
+  std::string m_lastModified;
+  std::vector<Segment> m_segments;
+  std::uint64_t m_downloaded = 0;
+  std::uint64_t m_reported = 0;
+  std::uint64_t m_unsavedBytes = 0;
+  std::uint64_t m_attempts = 0;
+  std::unique_ptr<ContentHash> m_hash;
+  std::uint64_t m_hashed = 0;
+  bool m_finished = false;
+};
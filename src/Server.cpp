@@ -1,7 +1,17 @@
 #include "Server.hpp"
+#include "Context.hpp"
 #include "Protocol.hpp"
 #include "Transport.hpp"
 
+#include <QCoreApplication>
+#include <QFuture>
+
+#include <cstdio>
+#include <utility>
+
+// device messages queued while the server does not keep up
+static constexpr std::size_t kMaxDeviceQueue = 4096;
+
 std::error_code Server::activate(Context &context) {
   if (m_process) {
     return std::make_error_code(std::errc::file_exists);
@@ -9,6 +19,13 @@ std::error_code Server::activate(Context &context) {
 
   auto launch = manifest().launch.value();
 
+  auto transport = createTransport(launch.transport, this);
+  if (transport == nullptr) {
+    std::fprintf(stderr, "unsupported transport '%s'\n",
+                 launch.transport.c_str());
+    return std::make_error_code(std::errc::protocol_not_supported);
+  }
+
   std::error_code ec;
 
   m_process = boost::process::child(
@@ -16,15 +33,262 @@ std::error_code Server::activate(Context &context) {
       boost::process::std_err > m_stderr, boost::process::std_in < m_stdin,
       m_process_group);
 
-  if (!ec) {
-    auto transport = createTransport(launch.transport, this);
-    m_protocol = createProtocol(launch.protocol, std::move(transport));
+  if (ec) {
+    return ec;
   }
 
-  return ec;
+  m_protocol = createProtocol(launch.protocol, std::move(transport));
+  if (m_protocol == nullptr) {
+    std::fprintf(stderr, "unsupported protocol '%s'\n",
+                 launch.protocol.c_str());
+    deactivate(context);
+    return std::make_error_code(std::errc::protocol_not_supported);
+  }
+
+  // calls and notifications of the server are handled by the UI thread like
+  // any other, responses go back through the protocol as long as it lives
+  std::weak_ptr<Protocol> weakProtocol = m_protocol;
+
+  m_protocol->setMethodHandler([&context, weakProtocol](
+                                   std::string_view name, MethodCallArgs args,
+                                   std::stop_token stopToken,
+                                   Protocol::ResponseHandler response) {
+    auto sharedResponse =
+        std::make_shared<Protocol::ResponseHandler>(std::move(response));
+
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        [&context, weakProtocol, name = std::string(name),
+         args = std::move(args), stopToken, sharedResponse] {
+          context
+              .callMethodAsync(name, {}, args, {.stopToken = stopToken})
+              .then(QCoreApplication::instance(),
+                    [weakProtocol, sharedResponse](MethodCallResult result) {
+                      if (weakProtocol.lock() != nullptr) {
+                        (*sharedResponse)(std::move(result));
+                      }
+                    });
+        },
+        Qt::QueuedConnection);
+  });
+
+  m_protocol->setNotificationHandler(
+      [&context](std::string_view name, NotificationArgs args) {
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [&context, name = std::string(name), args = std::move(args)] {
+              context.sendNotification(name, args);
+            },
+            Qt::QueuedConnection);
+      });
+
+  m_protocol->start();
+
+  // offered to the server, device messages keep going through the protocol
+  // until it accepts. nullptr where there is no shared memory transport
+  m_deviceTransport = createTransport("shm", this);
+
+  // binary encodings are preferred, device traffic then carries bytes as
+  // they are. until the server answers messages stay json
+  elp::InitializeRequest request{
+      .name = QCoreApplication::applicationName().toStdString(),
+      .version = QCoreApplication::applicationVersion().toStdString(),
+      .encodings =
+          {
+              std::string(getEncodingName(MessageEncoding::MessagePack)),
+              std::string(getEncodingName(MessageEncoding::Cbor)),
+              std::string(getEncodingName(MessageEncoding::Json)),
+          },
+      .deviceChannel = m_deviceTransport != nullptr
+                           ? m_deviceTransport->getAddress()
+                           : std::string(),
+  };
+
+  m_protocol->callMethod(
+      "initialize", request, {},
+      [this, &context, protocol = m_protocol.get(), weakProtocol,
+       deviceChannel = request.deviceChannel](MethodCallResult result) {
+        if (result.contains("error")) {
+          return;
+        }
+
+        elp::InitializeResponse response;
+        try {
+          response = result.get<elp::InitializeResponse>();
+        } catch (const std::exception &) {
+          std::fprintf(stderr, "invalid initialize response: %s\n",
+                       result.dump().c_str());
+          return;
+        }
+
+        auto encoding = findEncoding(response.encoding);
+        auto openDeviceChannel = !deviceChannel.empty() &&
+                                 response.deviceChannel == deviceChannel;
+
+        // answers are handled by the reader of the protocol, which keeps the
+        // protocol alive and decodes the next message with the new encoding
+        if (encoding) {
+          protocol->setEncoding(*encoding);
+        }
+
+        if (openDeviceChannel) {
+          QMetaObject::invokeMethod(
+              QCoreApplication::instance(),
+              [this, &context, weakProtocol] {
+                // the server was deactivated meanwhile
+                if (weakProtocol.lock() != nullptr) {
+                  startDeviceChannel(context);
+                }
+              },
+              Qt::QueuedConnection);
+        }
+      });
+  return {};
 }
 
 std::error_code Server::deactivate(Context &context) {
-  // TODO
-  return {};
+  std::error_code ec;
+
+  if (m_process) {
+    // the protocol stops reading once the pipes of the server are closed
+    m_process_group.terminate(ec);
+    m_process.wait(ec);
+    m_process = {};
+  }
+
+  if (m_deviceTransport != nullptr) {
+    // unsent device messages are dropped with the server
+    m_deviceTransport->close();
+    m_deviceReader = {};
+    m_deviceWriter = {};
+    m_deviceQueue.clear();
+    m_deviceTransport = nullptr;
+    m_deviceChannelOpen = false;
+  }
+
+  m_protocol = nullptr;
+  return ec;
+}
+
+void Server::startDeviceChannel(Context &context) {
+  m_deviceChannelOpen = true;
+
+  // device messages of the server are posted to the UI thread like the
+  // notifications of the protocol
+  m_deviceReader = std::jthread([this, &context] {
+    std::span<char> bytes;
+    while (m_deviceTransport->receive(bytes) == std::errc{}) {
+      auto args = nlohmann::json::from_msgpack(bytes, true, false);
+      if (args.is_discarded()) {
+        std::fprintf(stderr, "invalid device message\n");
+        continue;
+      }
+
+      QMetaObject::invokeMethod(
+          QCoreApplication::instance(),
+          [&context, args = std::move(args)] {
+            context.sendNotification(elp::kDeviceMessageMethod, args);
+          },
+          Qt::QueuedConnection);
+    }
+  });
+
+  m_deviceWriter = std::jthread([this](std::stop_token stopToken) {
+    runDeviceWriter(std::move(stopToken));
+  });
+}
+
+void Server::runDeviceWriter(std::stop_token stopToken) {
+  std::unique_lock lock(m_deviceMutex);
+
+  while (true) {
+    m_deviceCv.wait(lock, stopToken, [&] { return !m_deviceQueue.empty(); });
+    if (stopToken.stop_requested()) {
+      return;
+    }
+
+    auto messages = std::exchange(m_deviceQueue, {});
+    lock.unlock();
+
+    for (auto &message : messages) {
+      auto error = m_deviceTransport->sendMessage(
+          {reinterpret_cast<const char *>(message.data()), message.size()});
+
+      if (error == std::errc::timed_out) {
+        // the server does not read its device channel for now
+        std::fprintf(stderr, "device message dropped: %s\n",
+                     std::make_error_code(error).message().c_str());
+        continue;
+      }
+
+      if (error != std::errc{}) {
+        std::fprintf(stderr, "device channel failed: %s\n",
+                     std::make_error_code(error).message().c_str());
+        return;
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+void Server::callMethod(
+    Context &context, std::string_view name, MethodCallArgs args,
+    std::move_only_function<void(MethodCallResult)> responseHandler) {
+  if (m_protocol == nullptr) {
+    responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
+    return;
+  }
+
+  auto sharedHandler =
+      std::make_shared<std::move_only_function<void(MethodCallResult)>>(
+          std::move(responseHandler));
+
+  m_protocol->callMethod(
+      name, std::move(args), {},
+      [sharedHandler](MethodCallResult result) {
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [sharedHandler, result = std::move(result)]() mutable {
+              (*sharedHandler)(std::move(result));
+            },
+            Qt::QueuedConnection);
+      });
+}
+
+void Server::callMethodAsync(
+    Context &context, std::string_view name, MethodCallArgs args,
+    std::stop_token stopToken,
+    std::move_only_function<void(MethodCallResult)> responseHandler) {
+  if (m_protocol == nullptr) {
+    responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
+    return;
+  }
+
+  // Context resolves the call from any thread, no need to post it
+  m_protocol->callMethod(name, std::move(args), std::move(stopToken),
+                         std::move(responseHandler));
+}
+
+void Server::handleNotification(Context &context, std::string_view name,
+                                NotificationArgs args) {
+  if (m_deviceChannelOpen && name == elp::kDeviceMessageMethod) {
+    // never falls back to the protocol, that would reorder device messages
+    {
+      std::lock_guard lock(m_deviceMutex);
+      if (m_deviceQueue.size() >= kMaxDeviceQueue) {
+        std::fprintf(stderr, "device channel is full, message dropped\n");
+        return;
+      }
+
+      m_deviceQueue.push_back(nlohmann::json::to_msgpack(args));
+    }
+
+    m_deviceCv.notify_one();
+    return;
+  }
+
+  if (m_protocol != nullptr) {
+    m_protocol->sendNotification(name, std::move(args));
+  }
 }
@@ -2,11 +2,17 @@
 
 #include "Alternative.hpp"
 #include "Protocol.hpp"
+#include "Transport.hpp"
 
 #include <boost/process.hpp>
 
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <system_error>
+#include <thread>
+#include <vector>
 
 struct Server : Alternative {
   using Alternative::Alternative;
@@ -14,6 +20,17 @@ struct Server : Alternative {
   std::error_code activate(Context &context) override;
   std::error_code deactivate(Context &context) override;
 
+  // responseHandler is called on the UI thread
+  void callMethod(Context &context, std::string_view name, MethodCallArgs args,
+                  std::move_only_function<void(MethodCallResult)>
+                      responseHandler) override;
+  void callMethodAsync(Context &context, std::string_view name,
+                       MethodCallArgs args, std::stop_token stopToken,
+                       std::move_only_function<void(MethodCallResult)>
+                           responseHandler) override;
+  void handleNotification(Context &context, std::string_view name,
+                          NotificationArgs args) override;
+
   Protocol *protocol() { return m_protocol.get(); }
 
   boost::process::ipstream &getStdout() { return m_stdout; }
@@ -21,11 +38,27 @@ struct Server : Alternative {
   boost::process::opstream &getStdin() { return m_stdin; }
 
 private:
+  void startDeviceChannel(Context &context);
+  void runDeviceWriter(std::stop_token stopToken);
+
   boost::process::group m_process_group;
   boost::process::child m_process;
   boost::process::ipstream m_stdout;
   boost::process::ipstream m_stderr;
   boost::process::opstream m_stdin;
 
-  std::unique_ptr<Protocol> m_protocol;
+  // shared so that calls of the server answered after deactivate can tell
+  std::shared_ptr<Protocol> m_protocol;
+
+  // device messages bypass the protocol once the server opened the channel,
+  // see elp::InitializeResponse::deviceChannel
+  std::unique_ptr<Transport> m_deviceTransport;
+  bool m_deviceChannelOpen = false;
+  std::jthread m_deviceReader;
+  // device messages are written by m_deviceWriter, a server that reads
+  // slowly must not block the UI thread
+  std::mutex m_deviceMutex;
+  std::condition_variable_any m_deviceCv;
+  std::vector<std::vector<std::uint8_t>> m_deviceQueue;
+  std::jthread m_deviceWriter;
 };
@@ -0,0 +1,206 @@
+#include "SettingsJournal.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+// changes recorded within this window are written together
+static constexpr auto kDebounce = std::chrono::milliseconds(20);
+
+static constexpr std::uint64_t kCompactSize = 1024 * 1024;
+
+nlohmann::json SettingsJournal::open(std::filesystem::path snapshotPath) {
+  close();
+
+  m_snapshotPath = std::move(snapshotPath);
+  m_journalPath = m_snapshotPath;
+  m_journalPath += ".journal";
+  m_settings = nullptr;
+
+  if (std::ifstream f{m_snapshotPath}) {
+    try {
+      f >> m_settings;
+    } catch (...) {
+      m_settings = nullptr;
+    }
+  }
+
+  if (std::ifstream f{m_journalPath}) {
+    for (std::string line; std::getline(f, line);) {
+      Change change;
+      try {
+        auto entry = nlohmann::json::parse(line);
+        change.path = entry.at("path").get<std::vector<std::string>>();
+        change.value = std::move(entry.at("value"));
+      } catch (...) {
+        // only the last line can be incomplete
+        break;
+      }
+
+      apply(m_settings, std::move(change));
+    }
+  }
+
+  // the journal may end with a torn line, so new changes go to a fresh one
+  compact();
+
+  m_thread = std::jthread([this](std::stop_token stopToken) {
+    run(std::move(stopToken));
+  });
+  return m_settings;
+}
+
+void SettingsJournal::close() {
+  if (m_thread.joinable()) {
+    m_thread.request_stop();
+    m_thread.join();
+  }
+
+  m_journal.close();
+}
+
+void SettingsJournal::record(std::vector<std::string> path,
+                             nlohmann::json value) {
+  {
+    std::lock_guard lock(m_mutex);
+    m_pending.push_back({std::move(path), std::move(value)});
+    ++m_recorded;
+  }
+  m_cv.notify_all();
+}
+
+void SettingsJournal::reset(nlohmann::json settings) {
+  close();
+
+  {
+    std::lock_guard lock(m_mutex);
+    m_pending.clear();
+    m_written = m_recorded;
+  }
+
+  m_settings = std::move(settings);
+  compact();
+
+  m_thread = std::jthread([this](std::stop_token stopToken) {
+    run(std::move(stopToken));
+  });
+}
+
+void SettingsJournal::flush() {
+  std::unique_lock lock(m_mutex);
+  if (!m_thread.joinable()) {
+    return;
+  }
+
+  auto target = m_recorded;
+  m_flushRequested = true;
+  m_cv.notify_all();
+  m_cv.wait(lock, [&] { return m_written >= target; });
+}
+
+void SettingsJournal::apply(nlohmann::json &settings, Change change) {
+  auto node = &settings;
+  for (auto &key : change.path) {
+    if (!node->is_object()) {
+      *node = nlohmann::json::object();
+    }
+    node = &(*node)[key];
+  }
+  *node = std::move(change.value);
+}
+
+void SettingsJournal::run(std::stop_token stopToken) {
+  std::unique_lock lock(m_mutex);
+
+  while (true) {
+    m_cv.wait(lock, stopToken, [&] { return !m_pending.empty(); });
+    if (m_pending.empty()) {
+      // stopped with nothing left to write
+      return;
+    }
+
+    if (!m_flushRequested && !stopToken.stop_requested()) {
+      // let a burst of changes, e.g. from dragging a slider, settle
+      m_cv.wait_for(lock, stopToken, kDebounce,
+                    [&] { return m_flushRequested; });
+    }
+
+    auto changes = std::exchange(m_pending, {});
+    auto recorded = m_recorded;
+    m_flushRequested = false;
+
+    lock.unlock();
+    write(std::move(changes));
+    lock.lock();
+
+    m_written = recorded;
+    m_cv.notify_all();
+  }
+}
+
+void SettingsJournal::write(std::vector<Change> changes) {
+  std::string lines;
+  for (auto &change : changes) {
+    lines += nlohmann::json{{"path", change.path}, {"value", change.value}}
+                 .dump();
+    lines += '\n';
+    apply(m_settings, std::move(change));
+  }
+
+  if (!m_journal.is_open() ||
+      !m_journal.write(lines.data(), lines.size()).flush()) {
+    std::fprintf(stderr, "failed to write settings journal '%s'\n",
+                 m_journalPath.string().c_str());
+
+    // the snapshot still gets every change
+    compact();
+    return;
+  }
+
+  m_journalSize += lines.size();
+  if (m_journalSize >= kCompactSize) {
+    compact();
+  }
+}
+
+bool SettingsJournal::compact() {
+  auto tmpPath = m_snapshotPath;
+  tmpPath += ".tmp";
+
+  {
+    std::ofstream f{tmpPath, std::ios::trunc};
+    if (!(f << m_settings) || !f.flush()) {
+      std::fprintf(stderr, "failed to write settings '%s'\n",
+                   tmpPath.string().c_str());
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, m_snapshotPath, ec);
+  if (ec) {
+    std::fprintf(stderr, "failed to replace settings '%s': %s\n",
+                 m_snapshotPath.string().c_str(), ec.message().c_str());
+    std::filesystem::remove(tmpPath, ec);
+    return false;
+  }
+
+  // a crash before the journal is truncated replays changes the snapshot
+  // has already, which is harmless
+  m_journal.close();
+  return openJournal();
+}
+
+bool SettingsJournal::openJournal() {
+  m_journal.clear();
+  m_journal.open(m_journalPath, std::ios::binary | std::ios::trunc);
+  if (!m_journal) {
+    std::fprintf(stderr, "failed to open settings journal '%s'\n",
+                 m_journalPath.string().c_str());
+    return false;
+  }
+
+  m_journalSize = 0;
+  return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Persists settings as a snapshot plus an append-only journal of changes next
+// to it. Changes are written by a background thread shortly after they are
+// recorded, batched within a short debounce window; once the journal grows
+// large, the snapshot is rewritten to a temporary file and renamed over the
+// old one. Changes are replayed in order on open, a torn last line from a
+// crash is ignored.
+class SettingsJournal {
+public:
+  SettingsJournal() = default;
+  SettingsJournal(const SettingsJournal &) = delete;
+  SettingsJournal &operator=(const SettingsJournal &) = delete;
+  ~SettingsJournal() { close(); }
+
+  // returns the snapshot at path with the journal applied, the result is
+  // compacted into a new snapshot before it is returned
+  nlohmann::json open(std::filesystem::path snapshotPath);
+
+  // writes outstanding changes and stops the writer
+  void close();
+
+  // records the value of a setting, path contains the keys of the objects
+  // from the root
+  void record(std::vector<std::string> path, nlohmann::json value);
+
+  // replaces all settings and writes a new snapshot
+  void reset(nlohmann::json settings);
+
+  // blocks until all recorded changes are written
+  void flush();
+
+private:
+  struct Change {
+    std::vector<std::string> path;
+    nlohmann::json value;
+  };
+
+  static void apply(nlohmann::json &settings, Change change);
+  void run(std::stop_token stopToken);
+  void write(std::vector<Change> changes);
+  bool compact();
+  bool openJournal();
+
+  std::filesystem::path m_snapshotPath;
+  std::filesystem::path m_journalPath;
+
+  std::mutex m_mutex;
+  std::condition_variable_any m_cv;
+  std::vector<Change> m_pending;
+  std::uint64_t m_recorded = 0;
+  std::uint64_t m_written = 0;
+  bool m_flushRequested = false;
+
+  // owned by the writer thread while it runs
+  nlohmann::json m_settings;
+  std::ofstream m_journal;
+  std::uint64_t m_journalSize = 0;
+
+  std::jthread m_thread;
+};
@@ -0,0 +1,336 @@
+#include "ShmTransport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// both processes use the words in the segment directly
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+static constexpr std::uint32_t kMagic = 0x504d5345; // "ESMP"
+static constexpr std::uint32_t kSpinCount = 4096;
+// upper bound of a single futex wait, a crashed peer cannot wake us so its
+// process is checked after each one
+static constexpr auto kWaitSlice = std::chrono::milliseconds(100);
+static constexpr auto kSendTimeout = std::chrono::seconds(1);
+
+// counters are offsets that wrap modulo 2^32, which the capacity divides
+struct ShmTransport::RingHeader {
+  alignas(64) std::atomic<std::uint32_t> head;
+  alignas(64) std::atomic<std::uint32_t> tail;
+  // futex words, bumped when the other side is about to sleep on them
+  alignas(64) std::atomic<std::uint32_t> dataSequence;
+  std::atomic<std::uint32_t> readerWaiting;
+  alignas(64) std::atomic<std::uint32_t> spaceSequence;
+  std::atomic<std::uint32_t> writerWaiting;
+};
+
+struct ShmTransport::Segment {
+  std::uint32_t magic;
+  std::uint32_t capacity;
+  std::atomic<std::uint32_t> closed;
+  // process of the creator, then of the server. 0 until it mapped the segment
+  std::atomic<std::uint32_t> pids[2];
+  // creator to server, then server to creator
+  RingHeader rings[2];
+};
+
+// false if the wait timed out
+static bool futexWait(std::atomic<std::uint32_t> &word,
+                      std::uint32_t expected) {
+  timespec timeout{
+      .tv_sec = 0,
+      .tv_nsec = std::chrono::nanoseconds(kWaitSlice).count(),
+  };
+  return syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word),
+                 FUTEX_WAIT, expected, &timeout, nullptr, 0) == 0 ||
+         errno != ETIMEDOUT;
+}
+
+static void futexWake(std::atomic<std::uint32_t> &word) {
+  word.fetch_add(1);
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE,
+          INT_MAX, nullptr, nullptr, 0);
+}
+
+void ShmTransport::Ring::write(std::uint32_t offset, const void *src,
+                               std::size_t size) {
+  auto index = offset & (capacity - 1);
+  auto first = std::min<std::size_t>(size, capacity - index);
+  std::memcpy(data + index, src, first);
+  std::memcpy(data, static_cast<const char *>(src) + first, size - first);
+}
+
+void ShmTransport::Ring::read(std::uint32_t offset, void *dest,
+                              std::size_t size) const {
+  auto index = offset & (capacity - 1);
+  auto first = std::min<std::size_t>(size, capacity - index);
+  std::memcpy(dest, data + index, first);
+  std::memcpy(static_cast<char *>(dest) + first, data, size - first);
+}
+
+ShmTransport::~ShmTransport() {
+  if (m_segment != nullptr) {
+    close();
+  }
+
+  if (m_memory != nullptr) {
+    munmap(m_memory, m_size);
+  }
+
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+
+  if (m_peerFd >= 0) {
+    ::close(m_peerFd);
+  }
+
+  if (m_creator) {
+    shm_unlink(m_name.c_str());
+  }
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::create(std::size_t capacity) {
+  static std::atomic<unsigned> nextIndex;
+
+  capacity = std::bit_ceil(std::max<std::size_t>(capacity, 4096));
+  if (capacity > (std::size_t(1) << 30)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<ShmTransport> result(new ShmTransport());
+  result->m_name = "/elp-" + std::to_string(getpid()) + "-" +
+                   std::to_string(nextIndex++);
+  result->m_fd = shm_open(result->m_name.c_str(), O_CREAT | O_EXCL | O_RDWR,
+                          S_IRUSR | S_IWUSR);
+  if (result->m_fd < 0) {
+    std::fprintf(stderr, "failed to create shared memory '%s': %s\n",
+                 result->m_name.c_str(), std::strerror(errno));
+    return nullptr;
+  }
+  result->m_creator = true;
+
+  auto size = sizeof(Segment) + 2 * capacity;
+  if (ftruncate(result->m_fd, size) != 0 ||
+      !result->map(result->m_fd, size, true)) {
+    std::fprintf(stderr, "failed to map shared memory '%s': %s\n",
+                 result->m_name.c_str(), std::strerror(errno));
+    return nullptr;
+  }
+
+  return result;
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::open(const std::string &name) {
+  std::unique_ptr<ShmTransport> result(new ShmTransport());
+  result->m_name = name;
+  result->m_fd = shm_open(name.c_str(), O_RDWR, 0);
+
+  struct stat info;
+  if (result->m_fd < 0 || fstat(result->m_fd, &info) != 0 ||
+      std::size_t(info.st_size) < sizeof(Segment) ||
+      !result->map(result->m_fd, info.st_size, false)) {
+    std::fprintf(stderr, "failed to open shared memory '%s': %s\n",
+                 name.c_str(), std::strerror(errno));
+    return nullptr;
+  }
+
+  return result;
+}
+
+bool ShmTransport::map(int fd, std::size_t size, bool creator) {
+  auto memory =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  m_memory = memory;
+  m_size = size;
+
+  if (creator) {
+    // the file is zero filled, which is a valid initial state for the
+    // atomics
+    m_segment = new (memory) Segment{};
+    m_segment->capacity = (size - sizeof(Segment)) / 2;
+    m_segment->magic = kMagic;
+  } else {
+    m_segment = static_cast<Segment *>(memory);
+    auto capacity = m_segment->capacity;
+    if (m_segment->magic != kMagic || !std::has_single_bit(capacity) ||
+        sizeof(Segment) + 2 * std::size_t(capacity) > size) {
+      errno = EINVAL;
+      m_segment = nullptr;
+      return false;
+    }
+  }
+
+  auto capacity = m_segment->capacity;
+  auto data = static_cast<char *>(memory) + sizeof(Segment);
+  Ring rings[2] = {
+      {&m_segment->rings[0], data, capacity},
+      {&m_segment->rings[1], data + capacity, capacity},
+  };
+
+  m_send = rings[creator ? 0 : 1];
+  m_receive = rings[creator ? 1 : 0];
+  m_segment->pids[creator ? 0 : 1] = static_cast<std::uint32_t>(getpid());
+  return true;
+}
+
+bool ShmTransport::isPeerAlive() {
+  std::lock_guard lock(m_peerMutex);
+  if (m_peerFd < 0) {
+    auto pid = static_cast<pid_t>(m_segment->pids[m_creator ? 1 : 0]);
+    if (pid == 0) {
+      // not connected yet, the owner of the transport gives up on it
+      return true;
+    }
+
+    // a pidfd also reports a child that exited but was not reaped yet, and
+    // cannot be confused by a reused pid
+    m_peerFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (m_peerFd < 0) {
+      if (errno == ESRCH) {
+        return false;
+      }
+
+      // no pidfd support, a zombie still counts as alive here
+      return kill(pid, 0) == 0 || errno != ESRCH;
+    }
+  }
+
+  pollfd descriptor{.fd = m_peerFd, .events = POLLIN};
+  return poll(&descriptor, 1, 0) == 0;
+}
+
+std::errc ShmTransport::sendMessage(std::span<const char> bytes) {
+  auto &header = *m_send.header;
+  auto size = static_cast<std::uint32_t>(bytes.size());
+  auto required = sizeof(size) + std::uint64_t(bytes.size());
+  if (required > m_send.capacity) {
+    return std::errc::message_size;
+  }
+
+  // only this side writes head
+  auto head = header.head.load(std::memory_order_relaxed);
+  auto hasSpace = [&] {
+    return m_send.capacity - (head - header.tail) >= required;
+  };
+  auto deadline = std::chrono::steady_clock::now() + kSendTimeout;
+
+  while (!hasSpace()) {
+    if (m_segment->closed) {
+      return std::errc::broken_pipe;
+    }
+
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return std::errc::timed_out;
+    }
+
+    auto sequence = header.spaceSequence.load();
+    header.writerWaiting = 1;
+    if (!hasSpace() && !futexWait(header.spaceSequence, sequence) &&
+        !isPeerAlive()) {
+      header.writerWaiting = 0;
+      return std::errc::broken_pipe;
+    }
+    header.writerWaiting = 0;
+  }
+
+  if (m_segment->closed) {
+    return std::errc::broken_pipe;
+  }
+
+  m_send.write(head, &size, sizeof(size));
+  m_send.write(head + sizeof(size), bytes.data(), bytes.size());
+  header.head = head + static_cast<std::uint32_t>(required);
+
+  if (header.readerWaiting) {
+    futexWake(header.dataSequence);
+  }
+
+  return {};
+}
+
+std::errc ShmTransport::receive(std::span<char> &dest) {
+  auto &header = *m_receive.header;
+  // only this side writes tail
+  auto tail = header.tail.load(std::memory_order_relaxed);
+
+  // messages written before the peer closed the transport are still read
+  for (std::uint32_t spin = 0;
+       header.head.load(std::memory_order_acquire) == tail; ++spin) {
+    if (m_segment->closed) {
+      return std::errc::broken_pipe;
+    }
+
+    // on a single cpu the peer cannot run while we spin
+    static const auto spinCount =
+        std::thread::hardware_concurrency() > 1 ? kSpinCount : 0;
+    if (spin < spinCount) {
+      continue;
+    }
+
+    auto sequence = header.dataSequence.load();
+    header.readerWaiting = 1;
+    if (header.head == tail && !m_segment->closed &&
+        !futexWait(header.dataSequence, sequence) && !isPeerAlive()) {
+      // the peer died without closing, what it wrote before was read
+      header.readerWaiting = 0;
+      return std::errc::broken_pipe;
+    }
+    header.readerWaiting = 0;
+  }
+
+  // head is written by the peer, a corrupt segment must not make us read
+  // past the ring
+  std::uint32_t available = header.head.load(std::memory_order_acquire) - tail;
+  if (available > m_receive.capacity) {
+    return std::errc::bad_message;
+  }
+
+  std::uint32_t size;
+  m_receive.read(tail, &size, sizeof(size));
+  if (size > m_receive.capacity - sizeof(size) ||
+      std::uint64_t(size) + sizeof(size) > available) {
+    return std::errc::bad_message;
+  }
+
+  m_buffer.resize(size);
+  m_receive.read(tail + sizeof(size), m_buffer.data(), size);
+  header.tail = tail + sizeof(size) + size;
+
+  if (header.writerWaiting) {
+    futexWake(header.spaceSequence);
+  }
+
+  dest = m_buffer;
+  return {};
+}
+
+void ShmTransport::close() {
+  m_segment->closed = 1;
+
+  for (auto &ring : m_segment->rings) {
+    futexWake(ring.dataSequence);
+    futexWake(ring.spaceSequence);
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Transport.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Messages through a shared memory segment that holds two single producer,
+// single consumer byte rings, one per direction. The side that creates the
+// segment writes the first ring and reads the second. A reader spins briefly
+// and then sleeps on a futex in the segment, so a message does not wait for
+// a pipe or the scheduler when the peer is busy. Each side records its pid in
+// the segment, a waiting side fails with broken_pipe once the peer process
+// exited even if it never closed the transport.
+//
+// It carries device messages next to the protocol, the server finds the
+// segment by the name in InitializeRequest::deviceChannel.
+class ShmTransport final : public Transport {
+public:
+  static constexpr std::size_t kDefaultCapacity = 1024 * 1024;
+
+  ShmTransport(const ShmTransport &) = delete;
+  ShmTransport &operator=(const ShmTransport &) = delete;
+  ~ShmTransport() override;
+
+  // capacity of each ring is rounded up to a power of two, nullptr on failure
+  static std::unique_ptr<ShmTransport>
+  create(std::size_t capacity = kDefaultCapacity);
+  static std::unique_ptr<ShmTransport> open(const std::string &name);
+
+  const std::string &name() const { return m_name; }
+
+  // waits for space while the reader lags behind, timed_out if it does not
+  // catch up
+  std::errc sendMessage(std::span<const char> bytes) override;
+  void flush() override {}
+  std::errc receive(std::span<char> &dest) override;
+  std::errc receiveErrorStream(std::span<char> &dest) override {
+    return std::errc::not_supported;
+  }
+  void close() override;
+  std::string getAddress() override { return m_name; }
+
+private:
+  struct RingHeader;
+  struct Segment;
+  struct Ring {
+    RingHeader *header = nullptr;
+    char *data = nullptr;
+    std::uint32_t capacity = 0;
+
+    void write(std::uint32_t offset, const void *src, std::size_t size);
+    void read(std::uint32_t offset, void *dest, std::size_t size) const;
+  };
+
+  ShmTransport() = default;
+  bool map(int fd, std::size_t size, bool creator);
+  bool isPeerAlive();
+
+  std::string m_name;
+  bool m_creator = false;
+  int m_fd = -1;
+  void *m_memory = nullptr;
+  std::size_t m_size = 0;
+  Segment *m_segment = nullptr;
+  Ring m_send;
+  Ring m_receive;
+  std::vector<char> m_buffer;
+  // pidfd of the peer, opened once it connected
+  std::mutex m_peerMutex;
+  int m_peerFd = -1;
+};
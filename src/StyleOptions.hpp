@@ -1,9 +1,14 @@
 #pragma once
 
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
 #include <functional>
 #include <map>
 #include <qobject.h>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace detail {
@@ -16,35 +21,38 @@ template <typename... T> struct ArgTypeTest {
 
 template <typename ObjectT> struct StyleOptionHandlerList {
   std::map<std::string,
-           std::vector<std::function<void(ObjectT *, const QString &)>>,
+           std::vector<std::function<void(ObjectT *, std::string_view)>>,
            std::less<>>
       handlers;
 
   template <typename T> void add(std::string key, T &&cb) {
     auto handler = [key, cb = std::forward<T>(cb)](ObjectT *obj,
-                                                   const QString &value) {
-      bool ok = false;
+                                                   std::string_view value) {
       if constexpr (requires {
                       cb(obj, detail::ArgTypeTest<std::int64_t>());
                     }) {
-        auto convValue = value.toLongLong(&ok);
-        if (ok) {
+        std::int64_t convValue;
+        if (parseNumber(value, convValue)) {
           cb(obj, convValue);
           return;
         }
       } else if constexpr (requires {
                              cb(obj, detail::ArgTypeTest<double>());
                            }) {
-        auto convValue = value.toDouble(&ok);
-        if (ok) {
+        double convValue;
+        if (parseNumber(value, convValue)) {
           cb(obj, convValue);
           return;
         }
       } else if constexpr (requires {
-                             cb(obj, detail::ArgTypeTest<std::string,
-                                                         std::string_view>());
+                             cb(obj, detail::ArgTypeTest<std::string_view>());
                            }) {
-        cb(obj, value.toStdString());
+        cb(obj, value);
+        return;
+      } else if constexpr (requires {
+                             cb(obj, detail::ArgTypeTest<std::string>());
+                           }) {
+        cb(obj, std::string(value));
         return;
       } else if constexpr (requires { cb(obj, detail::ArgTypeTest<bool>()); }) {
         cb(obj, value == "true");
@@ -53,12 +61,20 @@ template <typename ObjectT> struct StyleOptionHandlerList {
         static_assert(false, "wrong argument type");
       }
 
-      std::fprintf(stderr, "failed to parse value '%s' for '%s'\n",
-                   value.toStdString().data(), key.c_str());
+      std::fprintf(stderr, "failed to parse value '%.*s' for '%s'\n",
+                   static_cast<int>(value.size()), value.data(), key.c_str());
     };
 
     handlers[std::move(key)].push_back(std::move(handler));
   }
+
+private:
+  template <typename T>
+  static bool parseNumber(std::string_view value, T &result) {
+    auto [ptr, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), result);
+    return ec == std::errc{} && ptr == value.data() + value.size();
+  }
 };
 
 template <typename LT, typename RT>
@@ -77,12 +93,18 @@ inline StyleOptionHandlerList<RT> operator|(const StyleOptionHandlerList<LT> &lh
   return std::move(rhs);
 }
 
+struct StyleOption {
+  std::string_view key;
+  std::string_view value;
+};
+
 class StyleOptions {
 public:
-  using Storage = std::map<std::string, QString, std::less<>>;
+  // sorted by key
+  using Storage = std::span<const StyleOption>;
 
   StyleOptions() = default;
-  StyleOptions(Storage storage) : m_storage(std::move(storage)) {}
+  StyleOptions(Storage storage) : m_storage(storage) {}
 
   template <typename T, typename U = T>
   U *visit(const StyleOptionHandlerList<T> &list, U *object) const {
@@ -90,32 +112,37 @@ public:
     auto handlerIt = list.handlers.begin();
 
     while (it != m_storage.end() && handlerIt != list.handlers.end()) {
-      auto cmpResult = it->first <=> handlerIt->first;
+      auto cmpResult = it->key <=> handlerIt->first;
 
       if (cmpResult < 0) {
-        std::fprintf(stderr, "ignored option '%s'\n", it->first.c_str());
+        printIgnored(*it);
         ++it;
         continue;
       }
       if (cmpResult > 0) {
-        handlerIt = list.handlers.lower_bound(it->first);
+        handlerIt = list.handlers.lower_bound(it->key);
         continue;
       }
 
       for (auto &&handler : handlerIt->second) {
-        handler(object, it->second);
+        handler(object, it->value);
       }
       ++it;
       ++handlerIt;
     }
 
     for (; it != m_storage.end(); ++it) {
-      std::fprintf(stderr, "ignored option '%s'\n", it->first.c_str());
+      printIgnored(*it);
     }
 
     return object;
   }
 
 private:
+  static void printIgnored(const StyleOption &option) {
+    std::fprintf(stderr, "ignored option '%.*s'\n",
+                 static_cast<int>(option.key.size()), option.key.data());
+  }
+
   Storage m_storage;
 };
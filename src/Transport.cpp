@@ -1,6 +1,15 @@
 #include "Transport.hpp"
 #include "Server.hpp"
+
+#ifdef HAVE_SHM_TRANSPORT
+#include "ShmTransport.hpp"
+#endif
+
+#include <charconv>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <vector>
 
 class StdioTransport : public Transport {
 public:
@@ -24,22 +33,92 @@ public:
 
   void flush() override { in->flush(); }
 
-  std::errc receive(std::span<char> &dest) override { return {}; }
-  std::errc receiveErrorStream(std::span<char> &dest) override { return {}; }
+  std::errc receive(std::span<char> &dest) override {
+    std::optional<std::size_t> size;
+    std::string line;
+
+    // headers end with an empty line, only Content-Length is used
+    while (std::getline(*out, line)) {
+      if (line.ends_with('\r')) {
+        line.pop_back();
+      }
+
+      if (line.empty()) {
+        break;
+      }
+
+      if (line.starts_with(kContentLength)) {
+        auto value = std::string_view(line).substr(kContentLength.size());
+        while (value.starts_with(' ')) {
+          value.remove_prefix(1);
+        }
+
+        std::size_t parsed = 0;
+        auto [ptr, ec] =
+            std::from_chars(value.data(), value.data() + value.size(), parsed);
+        if (ec != std::errc{} || ptr != value.data() + value.size()) {
+          return std::errc::bad_message;
+        }
+        size = parsed;
+      }
+    }
+
+    if (!*out) {
+      return std::errc::broken_pipe;
+    }
+
+    if (!size || *size > kMaxMessageSize) {
+      return std::errc::bad_message;
+    }
+
+    buffer.resize(*size);
+    if (!out->read(buffer.data(), buffer.size())) {
+      return std::errc::broken_pipe;
+    }
+
+    dest = buffer;
+    return {};
+  }
+
+  std::errc receiveErrorStream(std::span<char> &dest) override {
+    if (!std::getline(*err, errorBuffer)) {
+      return std::errc::broken_pipe;
+    }
+
+    dest = errorBuffer;
+    return {};
+  }
 
 private:
+  static constexpr std::string_view kContentLength = "Content-Length:";
+  static constexpr std::size_t kMaxMessageSize = 64 * 1024 * 1024;
+
   std::ostream *in;
   std::istream *out;
   std::istream *err;
+  std::vector<char> buffer;
+  std::string errorBuffer;
 };
 
 std::unique_ptr<Transport> createTransport(std::string_view name,
                                            Server *executable) {
   if (name == "stdio") {
-    return std::make_unique<StdioTransport>(executable->getStdin(),
-                                            executable->getStdout(),
-                                            executable->getStderr());
+    return createStreamTransport(executable->getStdin(),
+                                 executable->getStdout(),
+                                 executable->getStderr());
   }
 
+#ifdef HAVE_SHM_TRANSPORT
+  if (name == "shm") {
+    return ShmTransport::create();
+  }
+#endif
+
   return nullptr;
 }
+
+std::unique_ptr<Transport> createStreamTransport(std::ostream &in,
+                                                 std::istream &out,
+                                                 std::istream &err) {
+  return std::make_unique<StdioTransport>(in, out, err);
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <iosfwd>
 #include <memory>
 #include <span>
+#include <string>
 #include <string_view>
 #include <system_error>
 
@@ -9,9 +11,25 @@ struct Transport {
   virtual ~Transport() = default;
   virtual std::errc sendMessage(std::span<const char> bytes) = 0;
   virtual void flush() = 0;
+  // blocks until a whole message is read, dest is set to it and stays valid
+  // until the next call. broken_pipe once the peer closed the transport
   virtual std::errc receive(std::span<char> &dest) = 0;
+  // reads the next line the peer wrote to its error stream
   virtual std::errc receiveErrorStream(std::span<char> &dest) = 0;
+  // wakes a blocked receive, which then fails with broken_pipe. transports
+  // that end with the server process do nothing
+  virtual void close() {}
+  // where the server process finds the transport, empty for transports it is
+  // handed at launch
+  virtual std::string getAddress() { return {}; }
 };
 
 class Server;
+// "stdio" carries the protocol. "shm" is a side channel the server is offered
+// in InitializeRequest::deviceChannel, nullptr where it is not built
 std::unique_ptr<Transport> createTransport(std::string_view name, Server *executable);
+// the framing of "stdio" over any streams, messages are written to in and
+// read from out
+std::unique_ptr<Transport> createStreamTransport(std::ostream &in,
+                                                 std::istream &out,
+                                                 std::istream &err);
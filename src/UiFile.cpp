@@ -1,9 +1,57 @@
 #include "UiFile.hpp"
+#include "BinaryStream.hpp"
 
-static std::unique_ptr<SchemaNode>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+static constexpr char kMagic[4] = {'E', 'L', 'P', 'U'};
+static constexpr std::uint32_t kVersion = 1;
+
+namespace {
+struct ParsedNode {
+  std::string id;
+  std::string type;
+  std::string def;
+  std::string valueMethod;
+  std::string text;
+  std::string title;
+  bool required = false;
+  bool supportsHotChange = false;
+  std::string styleHint;
+  std::map<std::string, std::string, std::less<>> styleOptions;
+  std::vector<std::unique_ptr<ParsedNode>> children;
+};
+
+enum NodeFlags : std::uint32_t {
+  kRequired = 1 << 0,
+  kSupportsHotChange = 1 << 1,
+};
+
+// strings are stored once, as offset and size into the string table
+struct StringTable {
+  std::string data;
+  std::unordered_map<std::string_view, std::uint32_t> offsets;
+
+  void write(BinaryWriter &writer, std::string_view string) {
+    auto [it, inserted] =
+        offsets.emplace(string, static_cast<std::uint32_t>(data.size()));
+    if (inserted) {
+      data += string;
+    }
+    writer.write(it->second);
+    writer.write(static_cast<std::uint32_t>(string.size()));
+  }
+};
+} // namespace
+
+static std::unique_ptr<ParsedNode>
 genSchemaUiNode(std::string styleHint, std::string text,
-                std::map<std::string, QString, std::less<>> &properties) {
-  auto result = std::make_unique<SchemaNode>();
+                std::map<std::string, std::string, std::less<>> &properties) {
+  auto result = std::make_unique<ParsedNode>();
   if (auto it = properties.find("required"); it != properties.end()) {
     result->required = it->second == "true";
     properties.erase(it);
@@ -15,27 +63,26 @@ genSchemaUiNode(std::string styleHint, std::string text,
   }
 
   if (auto it = properties.find("type"); it != properties.end()) {
-    result->type = it->second.toStdString();
+    result->type = it->second;
     properties.erase(it);
   }
 
   if (auto it = properties.find("default"); it != properties.end()) {
-    result->def = it->second.toStdString();
+    result->def = it->second;
   }
 
   result->styleHint = std::move(styleHint);
   result->valueMethod = std::move(text);
-  result->styleOptions = {std::move(properties)};
+  result->styleOptions = std::move(properties);
   return result;
 }
 
-static std::unique_ptr<SchemaNode> parseUiTree(IdToSchemaMap &idMap,
-                                               QXmlStreamReader &reader) {
-  std::unique_ptr<SchemaNode> result;
-  std::vector<SchemaNode *> stack;
+static std::unique_ptr<ParsedNode> parseUiTree(QXmlStreamReader &reader) {
+  std::unique_ptr<ParsedNode> result;
+  std::vector<ParsedNode *> stack;
   bool seenStart = false;
 
-  std::map<std::string, QString, std::less<>> properties;
+  std::map<std::string, std::string, std::less<>> properties;
   std::string name;
   std::string id;
   std::string text;
@@ -44,11 +91,7 @@ static std::unique_ptr<SchemaNode> parseUiTree(IdToSchemaMap &idMap,
     auto node = genSchemaUiNode(std::move(name), std::move(text), properties);
     auto parent = stack.empty() ? nullptr : stack.back();
     stack.push_back(node.get());
-
-    if (!id.empty()) {
-      node->id = id;
-      idMap[std::move(id)] = node.get();
-    }
+    node->id = std::move(id);
 
     if (result == nullptr) {
       result = std::move(node);
@@ -70,11 +113,11 @@ static std::unique_ptr<SchemaNode> parseUiTree(IdToSchemaMap &idMap,
 
       for (auto &attr : reader.attributes()) {
         properties[attr.name().toString().toStdString()] =
-            attr.value().toString();
+            attr.value().toString().toStdString();
       }
 
       if (auto it = properties.find("id"); it != properties.end()) {
-        id = it->second.toStdString();
+        id = std::move(it->second);
         properties.erase(it);
       } else {
         id = {};
@@ -109,7 +152,186 @@ static std::unique_ptr<SchemaNode> parseUiTree(IdToSchemaMap &idMap,
   return result;
 }
 
-std::unique_ptr<SchemaNode> parseUiFile(IdToSchemaMap &idMap, QByteArray xml) {
-  QXmlStreamReader xmlReader{xml};
-  return parseUiTree(idMap, xmlReader);
+std::string UiSchema::compile(const QByteArray &xml) {
+  QXmlStreamReader reader{xml};
+  auto root = parseUiTree(reader);
+  if (root == nullptr) {
+    return {};
+  }
+
+  // breadth first, so the children of every node are contiguous
+  std::vector<const ParsedNode *> nodes{root.get()};
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    for (auto &child : nodes[i]->children) {
+      nodes.push_back(child.get());
+    }
+  }
+
+  std::string nodeData;
+  std::string optionData;
+  std::string idData;
+  BinaryWriter nodeWriter{nodeData};
+  BinaryWriter optionWriter{optionData};
+  BinaryWriter idWriter{idData};
+  StringTable strings;
+
+  std::map<std::string_view, std::uint32_t> ids;
+  std::uint32_t nextChild = 1;
+  std::uint32_t optionCount = 0;
+
+  for (std::uint32_t index = 0; auto node : nodes) {
+    for (auto string : {&node->id, &node->type, &node->def,
+                        &node->valueMethod, &node->text, &node->title,
+                        &node->styleHint}) {
+      strings.write(nodeWriter, *string);
+    }
+
+    nodeWriter.write(static_cast<std::uint32_t>(
+        (node->required ? kRequired : 0) |
+        (node->supportsHotChange ? kSupportsHotChange : 0)));
+    nodeWriter.write(nextChild);
+    nodeWriter.write(static_cast<std::uint32_t>(node->children.size()));
+    nodeWriter.write(optionCount);
+    nodeWriter.write(static_cast<std::uint32_t>(node->styleOptions.size()));
+    nextChild += static_cast<std::uint32_t>(node->children.size());
+
+    for (auto &[key, value] : node->styleOptions) {
+      strings.write(optionWriter, key);
+      strings.write(optionWriter, value);
+      ++optionCount;
+    }
+
+    if (!node->id.empty()) {
+      ids[node->id] = index;
+    }
+
+    ++index;
+  }
+
+  for (auto &[id, index] : ids) {
+    strings.write(idWriter, id);
+    idWriter.write(index);
+  }
+
+  std::string result(kMagic, sizeof(kMagic));
+  BinaryWriter writer{result};
+  writer.write(kVersion);
+  writer.write(static_cast<std::uint32_t>(nodes.size()));
+  writer.write(optionCount);
+  writer.write(static_cast<std::uint32_t>(ids.size()));
+  writer.write(static_cast<std::uint32_t>(strings.data.size()));
+  result += nodeData;
+  result += optionData;
+  result += idData;
+  result += strings.data;
+  return result;
+}
+
+std::shared_ptr<const UiSchema> UiSchema::load(std::string data) {
+  auto schema = std::make_shared<UiSchema>();
+  schema->m_data = std::move(data);
+
+  try {
+    BinaryReader reader{schema->m_data};
+    if (!reader.readMagic(kMagic) ||
+        reader.read<std::uint32_t>() != kVersion) {
+      return nullptr;
+    }
+
+    auto nodeCount = reader.read<std::uint32_t>();
+    auto optionCount = reader.read<std::uint32_t>();
+    auto idCount = reader.read<std::uint32_t>();
+    auto stringsSize = reader.read<std::uint32_t>();
+
+    // every record is at least 8 bytes, reject counts the data cannot hold
+    // before allocating for them
+    if (std::uint64_t(nodeCount) + optionCount + idCount >
+        reader.data.size() / 8) {
+      return nullptr;
+    }
+
+    reader.check(stringsSize);
+    std::string_view strings(
+        reader.data.data() + reader.data.size() - stringsSize, stringsSize);
+
+    auto readString = [&] {
+      auto offset = reader.read<std::uint32_t>();
+      auto size = reader.read<std::uint32_t>();
+      if (std::uint64_t(offset) + size > strings.size()) {
+        throw std::runtime_error("string out of bounds");
+      }
+      return strings.substr(offset, size);
+    };
+
+    // spans below point into these, they must not reallocate
+    schema->m_nodes.resize(nodeCount);
+    schema->m_options.resize(optionCount);
+    schema->m_ids.reserve(idCount);
+
+    for (std::uint32_t i = 0; i < nodeCount; ++i) {
+      auto &node = schema->m_nodes[i];
+      node.id = readString();
+      node.type = readString();
+      node.def = readString();
+      node.valueMethod = readString();
+      node.text = readString();
+      node.title = readString();
+      node.styleHint = readString();
+
+      auto flags = reader.read<std::uint32_t>();
+      node.required = (flags & kRequired) != 0;
+      node.supportsHotChange = (flags & kSupportsHotChange) != 0;
+
+      auto firstChild = reader.read<std::uint32_t>();
+      auto childCount = reader.read<std::uint32_t>();
+      auto firstOption = reader.read<std::uint32_t>();
+      auto nodeOptionCount = reader.read<std::uint32_t>();
+
+      // children come after their parent, which also rules out cycles
+      if ((childCount != 0 && firstChild <= i) ||
+          std::uint64_t(firstChild) + childCount > nodeCount ||
+          std::uint64_t(firstOption) + nodeOptionCount > optionCount) {
+        return nullptr;
+      }
+
+      node.children = std::span(schema->m_nodes).subspan(firstChild,
+                                                         childCount);
+      node.styleOptions = std::span<const StyleOption>(
+          schema->m_options.data() + firstOption, nodeOptionCount);
+    }
+
+    for (auto &option : schema->m_options) {
+      option.key = readString();
+      option.value = readString();
+    }
+
+    for (std::uint32_t i = 0; i < idCount; ++i) {
+      auto id = readString();
+      auto index = reader.read<std::uint32_t>();
+      if (index >= nodeCount) {
+        return nullptr;
+      }
+      schema->m_ids.emplace_back(id, &schema->m_nodes[index]);
+    }
+
+    if (reader.data.size() != stringsSize ||
+        !std::ranges::is_sorted(schema->m_ids, {},
+                                &decltype(schema->m_ids)::value_type::first)) {
+      return nullptr;
+    }
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+
+  return schema;
+}
+
+const SchemaNode *UiSchema::find(std::string_view id) const {
+  auto it = std::ranges::lower_bound(m_ids, id, {}, [](auto &entry) {
+    return entry.first;
+  });
+  if (it == m_ids.end() || it->first != id) {
+    return nullptr;
+  }
+  return it->second;
 }
@@ -1,23 +1,59 @@
 #pragma once
 #include "StyleOptions.hpp"
-#include <QXmlStreamReader>
 
+#include <QByteArray>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Strings of a node point into the storage of its UiSchema
 struct SchemaNode {
-  virtual ~SchemaNode() = default;
-
-  std::string id;
-  std::string type;
-  std::string def;
-  std::string valueMethod;
-  std::string text;
-  std::string title;
+  std::string_view id;
+  std::string_view type;
+  std::string_view def;
+  std::string_view valueMethod;
+  std::string_view text;
+  std::string_view title;
   bool required = false;
   bool supportsHotChange = false;
-  std::string styleHint;
+  std::string_view styleHint;
   StyleOptions styleOptions;
-  std::vector<std::unique_ptr<SchemaNode>> children;
+  std::span<const SchemaNode> children;
 };
 
-using IdToSchemaMap = std::map<std::string, SchemaNode *, std::less<>>;
+// A parsed ui file. Nodes are stored breadth first in a single array, so the
+// children of a node are contiguous, and all strings share one buffer.
+//
+// The compiled form is that layout serialized with offsets instead of
+// pointers, loading it takes a fixed number of allocations regardless of the
+// number of nodes.
+class UiSchema {
+public:
+  // empty if xml has no elements
+  static std::string compile(const QByteArray &xml);
+
+  // nullptr if data is not a valid compiled schema
+  static std::shared_ptr<const UiSchema> load(std::string data);
+
+  static std::shared_ptr<const UiSchema> parse(const QByteArray &xml) {
+    return load(compile(xml));
+  }
 
-std::unique_ptr<SchemaNode> parseUiFile(IdToSchemaMap &idMap, QByteArray xml);
+  const SchemaNode *root() const {
+    return m_nodes.empty() ? nullptr : &m_nodes.front();
+  }
+
+  const SchemaNode *find(std::string_view id) const;
+
+private:
+  std::string m_data;
+  std::vector<SchemaNode> m_nodes;
+  std::vector<StyleOption> m_options;
+  // sorted by id
+  std::vector<std::pair<std::string_view, const SchemaNode *>> m_ids;
+};
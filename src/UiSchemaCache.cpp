@@ -0,0 +1,152 @@
+#include "UiSchemaCache.hpp"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFuture>
+
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+static constexpr auto kCompiledExtension = ".elpu";
+
+static std::string readCompiled(const std::filesystem::path &path) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return {};
+  }
+
+  std::string result(size, '\0');
+  std::ifstream file(path, std::ios::binary);
+  if (!file.read(result.data(), result.size())) {
+    return {};
+  }
+  return result;
+}
+
+static void writeCompiled(const std::filesystem::path &path,
+                          std::string_view data) {
+  // concurrent loads of the same file must not see a partial write
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.write(data.data(), data.size())) {
+      std::fprintf(stderr, "failed to write '%s'\n", tmpPath.c_str());
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmpPath, ec);
+  }
+}
+
+void UiSchemaCache::setCacheDirectory(std::filesystem::path path) {
+  std::error_code ec;
+  std::filesystem::create_directories(path, ec);
+
+  std::lock_guard lock(m_mutex);
+  m_cacheDirectory = std::move(path);
+}
+
+std::shared_ptr<const UiSchema> UiSchemaCache::parse(const QByteArray &xml) {
+  std::filesystem::path compiledPath;
+  {
+    std::lock_guard lock(m_mutex);
+    compiledPath = m_cacheDirectory;
+  }
+
+  if (!compiledPath.empty()) {
+    auto hash = QCryptographicHash::hash(xml, QCryptographicHash::Sha256);
+    compiledPath /= hash.toHex().toStdString() + kCompiledExtension;
+
+    if (auto schema = UiSchema::load(readCompiled(compiledPath))) {
+      return schema;
+    }
+  }
+
+  auto compiled = UiSchema::compile(xml);
+  auto schema = UiSchema::load(compiled);
+  if (schema != nullptr && !compiledPath.empty()) {
+    writeCompiled(compiledPath, compiled);
+  }
+  return schema;
+}
+
+std::shared_ptr<const UiSchema> UiSchemaCache::find(const std::string &key) {
+  std::lock_guard lock(m_mutex);
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    return nullptr;
+  }
+
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+  return it->second->second;
+}
+
+void UiSchemaCache::insert(std::string key,
+                           std::shared_ptr<const UiSchema> schema) {
+  std::lock_guard lock(m_mutex);
+  m_loading.erase(key);
+
+  if (auto it = m_index.find(key); it != m_index.end()) {
+    it->second->second = std::move(schema);
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return;
+  }
+
+  m_entries.emplace_front(key, std::move(schema));
+  m_index.emplace(std::move(key), m_entries.begin());
+
+  while (m_entries.size() > m_capacity) {
+    // users of an evicted schema keep their reference
+    m_index.erase(m_entries.back().first);
+    m_entries.pop_back();
+  }
+}
+
+std::shared_ptr<const UiSchema> UiSchemaCache::get(const Url &url) {
+  auto key = url.toString();
+  if (auto schema = find(key)) {
+    return schema;
+  }
+
+  if (!url.isLocalPath()) {
+    prefetch(url);
+    return nullptr;
+  }
+
+  QFile file(QString::fromStdString(url.toLocalPath().string()));
+  if (!file.open(QFile::ReadOnly)) {
+    std::fprintf(stderr, "failed to open ui file '%s'\n", key.c_str());
+    return nullptr;
+  }
+
+  auto schema = parse(file.readAll());
+  insert(std::move(key), schema);
+  return schema;
+}
+
+void UiSchemaCache::prefetch(const Url &url) {
+  auto key = url.toString();
+  {
+    std::lock_guard lock(m_mutex);
+    if (m_index.contains(key) || !m_loading.insert(key).second) {
+      return;
+    }
+  }
+
+  url.asyncGet(NetworkPriority::Visible)
+      .then(QtFuture::Launch::Async,
+            [this, key](QByteArray xml) { insert(key, parse(xml)); })
+      .onFailed([this, key] {
+        std::fprintf(stderr, "failed to fetch ui file '%s'\n", key.c_str());
+        std::lock_guard lock(m_mutex);
+        m_loading.erase(key);
+      });
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "UiFile.hpp"
+#include "Url.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+// Parsed ui files by url. Files are read on the first lookup or prefetch,
+// the least recently used schemas are dropped once more than capacity are
+// cached. Compiled schemas are kept in the cache directory, named by the hash
+// of their xml, so a file is only parsed again once its content changes.
+class UiSchemaCache {
+public:
+  explicit UiSchemaCache(std::size_t capacity = 32) : m_capacity(capacity) {}
+
+  // compiled schemas are not stored on disk until this is set
+  void setCacheDirectory(std::filesystem::path path);
+
+  // local files are parsed on the calling thread, remote ones return nullptr
+  // and start a prefetch
+  std::shared_ptr<const UiSchema> get(const Url &url);
+
+  // loads url in the background, e.g. when its tile is hovered
+  void prefetch(const Url &url);
+
+private:
+  using Entry = std::pair<std::string, std::shared_ptr<const UiSchema>>;
+
+  std::shared_ptr<const UiSchema> find(const std::string &key);
+  void insert(std::string key, std::shared_ptr<const UiSchema> schema);
+  std::shared_ptr<const UiSchema> parse(const QByteArray &xml);
+
+  std::mutex m_mutex;
+  std::filesystem::path m_cacheDirectory;
+  std::size_t m_capacity;
+  // most recently used first
+  std::list<Entry> m_entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+  std::set<std::string> m_loading;
+};
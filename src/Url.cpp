@@ -1,14 +1,20 @@
 #include "Url.hpp"
+#include "ByteChannel.hpp"
+#include "SegmentedDownload.hpp"
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QtConcurrent>
 
-static QNetworkAccessManager *getNetworkAccessManager() {
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+QNetworkAccessManager *Url::getNetworkAccessManager() {
   static auto *manager = new QNetworkAccessManager();
   return manager;
 }
 
-QFuture<QByteArray> Url::asyncGet() const {
+QFuture<QByteArray> Url::asyncGet(NetworkPriority priority) const {
   if (m_underlying.isLocalFile()) {
     return QtConcurrent::run([path=m_underlying.toLocalFile()] {
       QFile file(path);
@@ -19,16 +25,212 @@ QFuture<QByteArray> Url::asyncGet() const {
 
   QPromise<QByteArray> promise;
   auto result = promise.future();
-  QNetworkReply *reply =
-      getNetworkAccessManager()->get(QNetworkRequest(m_underlying));
-  QObject::connect(reply, &QNetworkReply::finished,
-                   [reply, promise = std::move(promise)] mutable {
-                     if (reply->error() == QNetworkReply::NoError) {
-                       promise.addResult(reply->readAll());
-                       promise.finish();
-                     } else {
-                       promise.setException(QException());
-                     }
-                   });
+  auto bytes = std::make_shared<QByteArray>();
+  NetworkScheduler::instance().get(
+      QNetworkRequest(m_underlying), priority,
+      {
+          .onData = [bytes](QNetworkReply *,
+                            QByteArray data) { bytes->append(data); },
+          .onFinished =
+              [bytes, promise = std::move(promise)](
+                  QNetworkReply *reply) mutable {
+                if (reply->error() == QNetworkReply::NoError) {
+                  promise.addResult(std::move(*bytes));
+                  promise.finish();
+                } else {
+                  promise.setException(QException());
+                }
+              },
+      });
+  return result;
+}
+
+// onFinished runs after channel was closed
+static void
+getStream(QNetworkRequest request, std::shared_ptr<ByteChannel> channel,
+          NetworkPriority priority,
+          std::move_only_function<void(QNetworkReply *)> onFinished) {
+  auto isFailed = [](QNetworkReply *reply) {
+    return reply->error() != QNetworkReply::NoError ||
+           reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                   .toInt() >= 400;
+  };
+
+  auto task = NetworkScheduler::instance().get(
+      std::move(request), priority,
+      {
+          .space =
+              [channel]() -> std::size_t {
+                // let onData see the cancellation
+                return channel->cancelled() ? 1 : channel->space();
+              },
+          .onData =
+              [channel, isFailed](QNetworkReply *reply, QByteArray bytes) {
+                if (channel->cancelled() || isFailed(reply)) {
+                  reply->abort();
+                  return;
+                }
+
+                channel->write(std::span(bytes.data(), bytes.size()));
+              },
+          .onFinished =
+              [channel, isFailed, onFinished = std::move(onFinished)](
+                  QNetworkReply *reply) mutable {
+                channel->close(isFailed(reply));
+                if (onFinished) {
+                  onFinished(reply);
+                }
+              },
+      });
+
+  channel->setOnSpace([task = std::weak_ptr(task)] {
+    QMetaObject::invokeMethod(Url::getNetworkAccessManager(), [task] {
+      if (auto locked = task.lock()) {
+        locked->resume();
+      }
+    });
+  });
+}
+
+void Url::asyncGetStream(std::shared_ptr<ByteChannel> channel,
+                         NetworkPriority priority) const {
+  getStream(QNetworkRequest(m_underlying), std::move(channel), priority,
+            nullptr);
+}
+
+static QNetworkRequest makeConditionalRequest(const QUrl &url,
+                                              const UrlValidators &validators) {
+  QNetworkRequest request(url);
+  if (!validators.etag.empty()) {
+    request.setRawHeader("If-None-Match",
+                         QByteArray::fromStdString(validators.etag));
+  }
+  if (!validators.lastModified.empty()) {
+    request.setRawHeader("If-Modified-Since",
+                         QByteArray::fromStdString(validators.lastModified));
+  }
+  return request;
+}
+
+static UrlValidators getReplyValidators(QNetworkReply *reply) {
+  return {
+      .etag = reply->rawHeader("ETag").toStdString(),
+      .lastModified = reply->rawHeader("Last-Modified").toStdString(),
+  };
+}
+
+QFuture<UrlFetchResult>
+Url::asyncGetStreamIfModified(std::shared_ptr<ByteChannel> channel,
+                              const UrlValidators &validators,
+                              NetworkPriority priority) const {
+  QPromise<UrlFetchResult> promise;
+  auto result = promise.future();
+
+  getStream(makeConditionalRequest(m_underlying, validators),
+            std::move(channel), priority,
+            [validators,
+             promise = std::move(promise)](QNetworkReply *reply) mutable {
+              auto status =
+                  reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                      .toInt();
+              if (status == 304) {
+                promise.addResult(UrlFetchResult{.notModified = true,
+                                                 .validators = validators});
+                promise.finish();
+                return;
+              }
+
+              if (reply->error() != QNetworkReply::NoError) {
+                promise.setException(QException());
+                return;
+              }
+
+              promise.addResult(
+                  UrlFetchResult{.validators = getReplyValidators(reply)});
+              promise.finish();
+            });
+  return result;
+}
+
+QFuture<bool> Url::asyncDownload(
+    std::filesystem::path target,
+    std::move_only_function<void(std::uint64_t, std::uint64_t)> onProgress,
+    NetworkPriority priority, std::string hash) const {
+  if (m_underlying.isLocalFile()) {
+    return QtConcurrent::run([source = toLocalPath(), target, hash] {
+      std::error_code ec;
+      std::filesystem::create_directories(target.parent_path(), ec);
+      return !ContentHash::copyFile(source, target, hash);
+    });
+  }
+
+  return SegmentedDownload::start(m_underlying, std::move(target),
+                                  std::move(onProgress), priority, hash);
+}
+
+static UrlValidators getLocalFileValidators(const QString &path) {
+  UrlValidators result;
+  auto nativePath = std::filesystem::path(path.toStdString());
+
+  std::error_code ec;
+  result.size = std::filesystem::file_size(nativePath, ec);
+  if (ec) {
+    return {};
+  }
+
+  result.mtime = std::filesystem::last_write_time(nativePath, ec)
+                     .time_since_epoch()
+                     .count();
+
+#ifndef _WIN32
+  struct stat fileStat;
+  if (::stat(nativePath.c_str(), &fileStat) == 0) {
+    result.inode = fileStat.st_ino;
+  }
+#endif
+
+  return result;
+}
+
+UrlValidators Url::getLocalValidators() const {
+  return getLocalFileValidators(m_underlying.toLocalFile());
+}
+
+QFuture<UrlFetchResult>
+Url::asyncGetIfModified(const UrlValidators &validators,
+                        NetworkPriority priority) const {
+  QPromise<UrlFetchResult> promise;
+  auto result = promise.future();
+  auto bytes = std::make_shared<QByteArray>();
+  NetworkScheduler::instance().get(
+      makeConditionalRequest(m_underlying, validators), priority,
+      {
+          .onData = [bytes](QNetworkReply *,
+                            QByteArray data) { bytes->append(data); },
+          .onFinished =
+              [bytes, validators,
+               promise = std::move(promise)](QNetworkReply *reply) mutable {
+                auto status =
+                    reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+                        .toInt();
+                if (status == 304) {
+                  promise.addResult(UrlFetchResult{
+                      .notModified = true, .validators = validators});
+                  promise.finish();
+                  return;
+                }
+
+                if (reply->error() != QNetworkReply::NoError) {
+                  promise.setException(QException());
+                  return;
+                }
+
+                promise.addResult(UrlFetchResult{
+                    .bytes = std::move(*bytes),
+                    .validators = getReplyValidators(reply),
+                });
+                promise.finish();
+              },
+      });
   return result;
 }
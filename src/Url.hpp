@@ -4,12 +4,27 @@
 #include <QFuture>
 #include <QUrl>
 
+#include "NetworkScheduler.hpp"
+#include "UrlValidators.hpp"
+
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <qdir.h>
 #include <string>
 #include <string_view>
 #include <type_traits>
 
+class ByteChannel;
+class QNetworkAccessManager;
+
+struct UrlFetchResult {
+  bool notModified = false;
+  QByteArray bytes;
+  UrlValidators validators;
+};
+
 class Url {
 public:
   Url() = default;
@@ -43,13 +58,52 @@ public:
   Url(const T &path)
       : m_underlying(QUrl::fromLocalFile(QString::fromUtf8(path.string()))) {}
 
-  QFuture<QByteArray> asyncGet() const;
+  // Requests go through NetworkScheduler, priority decides their order when
+  // the connection limits are reached
+  QFuture<QByteArray>
+  asyncGet(NetworkPriority priority = NetworkPriority::Background) const;
+
+  // Streams the resource into channel while it arrives, the reply reads more
+  // only after the consumer made room. The channel is closed at the end and
+  // marked as failed on errors. Must be called on the UI thread, before the
+  // consumer starts reading.
+  void asyncGetStream(
+      std::shared_ptr<ByteChannel> channel,
+      NetworkPriority priority = NetworkPriority::Interactive) const;
+
+  // Downloads the resource into target, see SegmentedDownload. Resolves to
+  // false on failure or if hash is set and does not match, calling it again
+  // with the same target resumes.
+  QFuture<bool> asyncDownload(
+      std::filesystem::path target,
+      std::move_only_function<void(std::uint64_t, std::uint64_t)> onProgress =
+          nullptr,
+      NetworkPriority priority = NetworkPriority::Interactive,
+      std::string hash = {}) const;
+
+  // Fetches the resource unless it still matches the validators of a
+  // previous fetch. Network only, local files are compared with
+  // getLocalValidators by the caller
+  QFuture<UrlFetchResult>
+  asyncGetIfModified(
+      const UrlValidators &validators,
+      NetworkPriority priority = NetworkPriority::Background) const;
+
+  // asyncGetIfModified into channel, see asyncGetStream. The future resolves
+  // after the channel was closed, bytes stay empty. A resource that still
+  // matches the validators leaves the channel empty
+  QFuture<UrlFetchResult> asyncGetStreamIfModified(
+      std::shared_ptr<ByteChannel> channel, const UrlValidators &validators,
+      NetworkPriority priority = NetworkPriority::Background) const;
+  UrlValidators getLocalValidators() const;
   std::string toString() const { return m_underlying.toString().toStdString(); }
   bool isLocalPath() const { return m_underlying.isLocalFile(); }
   std::filesystem::path toLocalPath() const {
     return m_underlying.toLocalFile().toStdString();
   }
 
+  static QNetworkAccessManager *getNetworkAccessManager();
+
   QUrl &underlying() { return m_underlying; }
   const QUrl &underlying() const { return m_underlying; }
 
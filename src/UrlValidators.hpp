@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Cache validators of a fetched resource. HTTP resources are revalidated with
+// ETag/Last-Modified, local files with their size, mtime and inode.
+struct UrlValidators {
+  std::string etag;
+  std::string lastModified;
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+  std::uint64_t inode = 0;
+
+  bool empty() const {
+    return etag.empty() && lastModified.empty() && size == 0 && mtime == 0 &&
+           inode == 0;
+  }
+
+  bool operator==(const UrlValidators &) const = default;
+};
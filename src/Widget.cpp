@@ -117,8 +117,9 @@ static QWidget *createWidgetImpl(std::string_view style,
   return styleOptions.visit(widgetOptionHandlers, new QWidget());
 }
 
-static QWidget *createWidget(QWidget *parent, SchemaNode *node,
-                             Settings &settings) {
+static QWidget *createWidget(QWidget *parent, const SchemaNode *node,
+                             Settings &settings,
+                             const std::function<void()> &onChanged) {
   auto result = createWidgetImpl(node->styleHint, node->styleOptions);
 
   if (parent == nullptr || node->styleHint == "group" ||
@@ -137,7 +138,7 @@ static QWidget *createWidget(QWidget *parent, SchemaNode *node,
   }
 
   for (auto &child : node->children) {
-    createWidget(result, child.get(), settings);
+    createWidget(result, &child, settings, onChanged);
   }
 
   if (!node->id.empty()) {
@@ -156,6 +157,9 @@ static QWidget *createWidget(QWidget *parent, SchemaNode *node,
           QObject::connect(btn, &QAbstractButton::clicked, [=](bool value) {
             if (value) {
               it.value() = btn->text().toStdString();
+              if (onChanged) {
+                onChanged();
+              }
             }
           });
         }
@@ -166,17 +170,22 @@ static QWidget *createWidget(QWidget *parent, SchemaNode *node,
         widget->setChecked(it.value().get<bool>());
       }
 
-      QObject::connect(widget, &QAbstractButton::toggled,
-                       [=](bool value) { it.value() = value; });
+      QObject::connect(widget, &QAbstractButton::toggled, [=](bool value) {
+        it.value() = value;
+        if (onChanged) {
+          onChanged();
+        }
+      });
     }
   }
 
   return result;
 }
 
-QWidget *createWidget(SchemaNode *node, Settings &settings) {
+QWidget *createWidget(const SchemaNode *node, Settings &settings,
+                      std::function<void()> onChanged) {
   if (!settings.is_object()) {
     settings = Settings::object();
   }
-  return createWidget(nullptr, node, settings);
+  return createWidget(nullptr, node, settings, onChanged);
 }
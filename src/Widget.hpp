@@ -2,7 +2,11 @@
 
 #include "Context.hpp"
 
+#include <functional>
+
 struct SchemaNode;
 class QWidget;
 
-QWidget *createWidget(SchemaNode *node, Settings &settings);
+// onChanged is called after the widget changed a value in settings
+QWidget *createWidget(const SchemaNode *node, Settings &settings,
+                      std::function<void()> onChanged = nullptr);
@@ -11,6 +11,7 @@
 #include <qsettings.h>
 #include <qstandardpaths.h>
 #include <string_view>
+#include <unordered_set>
 #include <utility>
 
 #include <QApplication>
@@ -302,7 +303,8 @@ struct AlternativeViewWidget : QGroupBox {
     label = new QLabel(this);
     label->setAlignment(Qt::AlignCenter);
 
-    label->setText(QString::fromStdString(manifest.displayId()));
+    auto displayId = alternative->id().display();
+    label->setText(QString::fromUtf8(displayId.data(), displayId.size()));
     label->setWordWrap(true);
     control = new QWidget(this);
     control->setLayout(new QHBoxLayout(control));
@@ -344,14 +346,14 @@ struct AlternativeViewWidget : QGroupBox {
 
         auto launchCb = [context = &context, this] {
           context->callMethodShowErrors("alternative/launch", {},
-                                        {{"id", alternative->manifest().id()}});
+                                        {{"id", alternative->id().str()}});
         };
 
         connect(launchBtn, &QToolButton::clicked, launchCb);
         connect(launchAct, &QAction::triggered, launchCb);
         connect(launchWithAct, &QAction::triggered, [context = &context, this] {
           context->callMethodShowErrors("alternative/launchWith", {},
-                                        {{"id", alternative->manifest().id()}});
+                                        {{"id", alternative->id().str()}});
         });
       }
     } else if (manifest.install) {
@@ -367,7 +369,7 @@ struct AlternativeViewWidget : QGroupBox {
 
       connect(installBtn, &QToolButton::clicked, [context = &context, this] {
         context->callMethodShowErrors("alternative/install", {},
-                                      {{"id", alternative->manifest().id()}});
+                                      {{"id", alternative->id().str()}});
       });
     } else if (manifest.download) {
       auto downloadBtn = new QToolButton(control);
@@ -382,7 +384,7 @@ struct AlternativeViewWidget : QGroupBox {
 
       connect(downloadBtn, &QToolButton::clicked, [context = &context, this] {
         context->callMethodShowErrors("alternative/download", {},
-                                      {{"id", alternative->manifest().id()}},
+                                      {{"id", alternative->id().str()}},
                                       [](auto) {});
       });
     }
@@ -402,8 +404,12 @@ struct AlternativeViewWidget : QGroupBox {
 
               connect(configAct, &QAction::triggered, this, [=, this] {
                 auto widget = createWidget(
-                    settingsSchema,
-                    context->getSettingsFor(alternative, "config/settings"));
+                    settingsSchema.get(),
+                    context->getSettingsFor(alternative, "config/settings"),
+                    [=, this] {
+                      context->commitSettingsFor(alternative,
+                                                 "config/settings");
+                    });
                 widget->setAttribute(Qt::WA_DeleteOnClose);
                 widget->show();
               });
@@ -439,7 +445,7 @@ struct AlternativeViewWidget : QGroupBox {
       auto url = Url::makeFromRelative(Url(alternative->manifest().path),
                                        alternative->manifest().icon);
 
-      initIconFuture = url.asyncGet().then(
+      initIconFuture = url.asyncGet(NetworkPriority::Visible).then(
           QtFuture::Launch::Async,
           [this, scaleSize = iconSvg->size(), url](QByteArray &&array) {
             if (array.isEmpty()) {
@@ -480,6 +486,8 @@ struct AlternativeViewWidget : QGroupBox {
 
   bool event(QEvent *event) override {
     if (event->type() == QEvent::HoverEnter) {
+      // the settings menu is likely next, fetch its schema meanwhile
+      alternative->prefetchUiSchema();
       control->setGeometry(QRect(0, 0, width(), 50));
       control->show();
       return true;
@@ -562,16 +570,30 @@ public:
     icons.push_back(iconView);
   }
 
-  void removeItem(std::string_view id) {
-    for (auto it = icons.begin(); it != icons.end(); ++it) {
-      if ((*it)->alternative->manifest().id() == id) {
-        auto iconView = *it;
-        icons.erase(it);
-        iconsGroup->layout()->removeWidget(iconView);
-        delete iconView;
-        return;
-      }
+  void addItems(std::vector<std::shared_ptr<Alternative>> items) {
+    iconsGroup->setUpdatesEnabled(false);
+    icons.reserve(icons.size() + items.size());
+    for (auto &item : items) {
+      addItem(std::move(item));
     }
+    iconsGroup->setUpdatesEnabled(true);
+  }
+
+  using IdSet =
+      std::unordered_set<ManifestId, ManifestId::Hash, std::equal_to<>>;
+
+  void removeItems(const IdSet &ids) {
+    iconsGroup->setUpdatesEnabled(false);
+    std::erase_if(icons, [&](AlternativeViewWidget *iconView) {
+      if (!ids.contains(iconView->alternative->id())) {
+        return false;
+      }
+
+      iconsGroup->layout()->removeWidget(iconView);
+      delete iconView;
+      return true;
+    });
+    iconsGroup->setUpdatesEnabled(true);
   }
 
   bool eventFilter(QObject *watched, QEvent *event) override {
@@ -614,65 +636,60 @@ createPackagesWidget(Context &context,
   widget->setFocusProxy(iconList);
   iconList->setFocus();
 
-  auto watchConnection = context.createNotificationHandler(
-      "packages/change", [=, context = &context](NotificationArgs args) {
-        if (args.contains("add")) {
-          for (auto &id : args["add"]) {
-            auto alt = context->findAlternativeById(id.get<std::string>());
-            if (alt == nullptr) {
-              continue;
-            }
+  auto isVisibleAlternative = [requirements = InternedRequirements(
+                                   requirements)](const Alternative &alt) {
+    if (alt.manifest().source.empty()) {
+      // ignore builtins and groups
+      return false;
+    }
 
-            if (alt->manifest().source.empty()) {
-              // ignore builtins and groups
-              continue;
-            }
+    if (!alt.manifest().install && !alt.manifest().download &&
+        !alt.manifest().launch) {
+      // no actions
+      return false;
+    }
 
-            if (!alt->manifest().install && !alt->manifest().download &&
-                !alt->manifest().launch) {
-              // no actions
-              continue;
-            }
+    return alt.match(requirements);
+  };
 
-            if (!alt->match(requirements)) {
-              continue;
-            }
+  auto watchConnection = context.createNotificationHandler(
+      "packages/change", [=, context = &context](NotificationArgs args) {
+        IconListViewWidget::IdSet removeIds;
+        std::vector<std::shared_ptr<Alternative>> addList;
 
-            QMetaObject::invokeMethod(iconList,
-                                      [iconList, alt = std::move(alt)] {
-                                        iconList->addItem(std::move(alt));
-                                      });
+        if (args.contains("remove")) {
+          for (auto &id : args["remove"]) {
+            removeIds.emplace(id.get<std::string>());
           }
         }
 
-        if (args.contains("remove")) {
-          for (auto &id : args["remove"]) {
-            QMetaObject::invokeMethod(iconList,
-                                      [iconList, id = id.get<std::string>()] {
-                                        iconList->removeItem(id);
-                                      });
+        if (args.contains("add")) {
+          // sources are ingested by workers while this runs
+          std::lock_guard lock(context->mutex);
+          for (auto &id : args["add"]) {
+            auto alt = context->findAlternativeById(id.get<std::string>());
+            if (alt != nullptr && isVisibleAlternative(*alt)) {
+              addList.push_back(std::move(alt));
+            }
           }
         }
-      });
 
-  for (auto &alt : context.allAlternatives) {
-    if (alt.second->manifest().source.empty()) {
-      // ignore builtins and groups
-      continue;
-    }
+        if (removeIds.empty() && addList.empty()) {
+          return;
+        }
 
-    if (!alt.second->manifest().install && !alt.second->manifest().download &&
-        !alt.second->manifest().launch) {
-      // no actions
-      continue;
-    }
+        iconList->removeItems(removeIds);
+        iconList->addItems(std::move(addList));
+      },
+      NotificationExecutor::Ui);
 
-    if (!alt.second->match(requirements)) {
-      continue;
+  std::vector<std::shared_ptr<Alternative>> initialList;
+  for (auto &alt : context.findAllAlternatives(requirements)) {
+    if (isVisibleAlternative(*alt)) {
+      initialList.push_back(std::move(alt));
     }
-
-    iconList->addItem(alt.second);
   }
+  iconList->addItems(std::move(initialList));
 
   QObject::connect(widget, &QWidget::destroyed,
                    [watchConnection = std::move(watchConnection)] mutable {
@@ -765,7 +782,17 @@ struct BuiltinAlternatives final : public Alternative {
   void callMethod(Context &context, std::string_view name, MethodCallArgs args,
                   std::move_only_function<void(MethodCallResult)>
                       responseHandler) override {
-    if (name == "view/show") {
+    callMethodById(context, findMethod(name), std::move(args),
+                   std::move(responseHandler));
+  }
+
+  void callMethodById(Context &context, MethodId method, MethodCallArgs args,
+                      std::move_only_function<void(MethodCallResult)>
+                          responseHandler) override {
+    static const auto kShow = internMethod("view/show");
+    static const auto kHide = internMethod("view/hide");
+
+    if (method == kShow) {
       auto id = args["id"].get<std::string>();
 
       if (id == "main") {
@@ -807,7 +834,7 @@ struct BuiltinAlternatives final : public Alternative {
       return;
     }
 
-    if (name == "view/hide") {
+    if (method == kHide) {
       auto id = args["id"].get<std::string>();
       if (id == "main") {
         mainWidget->hide();
@@ -820,29 +847,34 @@ struct BuiltinAlternatives final : public Alternative {
   }
 };
 
+using BuiltinMethodFn =
+    std::move_only_function<MethodCallResult(MethodCallArgs)>;
+
 struct BuiltinMethodHandler : Alternative {
-  std::map<std::string,
-           std::move_only_function<MethodCallResult(MethodCallArgs)>,
-           std::less<>>
-      methodHandlers;
+  MethodTable<BuiltinMethodFn> methodHandlers;
 
   BuiltinMethodHandler() : Alternative({.name = "Built-in method handler"}) {}
 
   void callMethod(Context &context, std::string_view name, MethodCallArgs args,
                   std::move_only_function<void(MethodCallResult)>
                       responseHandler) override {
-    if (auto it = methodHandlers.find(name); it != methodHandlers.end()) {
-      responseHandler(it->second(std::move(args)));
+    callMethodById(context, findMethod(name), std::move(args),
+                   std::move(responseHandler));
+  }
+
+  void callMethodById(Context &context, MethodId method, MethodCallArgs args,
+                      std::move_only_function<void(MethodCallResult)>
+                          responseHandler) override {
+    if (auto handler = methodHandlers.find(method)) {
+      responseHandler((*handler)(std::move(args)));
       return;
     }
 
     responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
   }
 
-  void addHandler(
-      std::string name,
-      std::move_only_function<MethodCallResult(MethodCallArgs)> handler) {
-    methodHandlers[std::move(name)] = std::move(handler);
+  void addHandler(std::string name, BuiltinMethodFn handler) {
+    methodHandlers.set(name, std::move(handler));
   }
 
   static std::shared_ptr<BuiltinMethodHandler> instance() {
@@ -852,10 +884,7 @@ struct BuiltinMethodHandler : Alternative {
 };
 
 struct BuiltinMethods final : Alternative {
-  std::map<std::string,
-           std::move_only_function<MethodCallResult(MethodCallArgs)>,
-           std::less<>>
-      methods;
+  MethodTable<BuiltinMethodFn> methods;
   BuiltinMethods()
       : Alternative(Manifest{
             .name = "Built-in methods",
@@ -868,6 +897,8 @@ struct BuiltinMethods final : Alternative {
                             "alternative/download",
                             "alternative/install",
                             "alternative/delete",
+                            "alternative/resolve-dependencies",
+                            "alternative/launch-settings",
                             "view/show",
                             "view/hide",
                         },
@@ -877,17 +908,22 @@ struct BuiltinMethods final : Alternative {
   void callMethod(Context &context, std::string_view name, MethodCallArgs args,
                   std::move_only_function<void(MethodCallResult)>
                       responseHandler) override {
-    if (auto it = methods.find(name); it != methods.end()) {
-      responseHandler(it->second(std::move(args)));
+    callMethodById(context, findMethod(name), std::move(args),
+                   std::move(responseHandler));
+  }
+
+  void callMethodById(Context &context, MethodId method, MethodCallArgs args,
+                      std::move_only_function<void(MethodCallResult)>
+                          responseHandler) override {
+    if (auto handler = methods.find(method)) {
+      responseHandler((*handler)(std::move(args)));
     } else {
       responseHandler({{"error", elp::ErrorCode::MethodNotFound}});
     }
   }
 
-  void setMethodHandler(
-      std::string name,
-      std::move_only_function<MethodCallResult(MethodCallArgs)> handler) {
-    methods[std::move(name)] = std::move(handler);
+  void setMethodHandler(std::string name, BuiltinMethodFn handler) {
+    methods.set(name, std::move(handler));
   }
 };
 
@@ -926,7 +962,10 @@ int main(int argc, char *argv[]) {
 
   builtinMethodHandlers->setMethodHandler(
       "alternative/download",
-      [&](const MethodCallArgs &args) -> MethodCallResult { return {}; });
+      [&](const MethodCallArgs &args) -> MethodCallResult {
+        context.downloadPackage(args.at("id").get<std::string>());
+        return {};
+      });
 
   builtinMethodHandlers->setMethodHandler(
       "alternative/install",
@@ -938,6 +977,38 @@ int main(int argc, char *argv[]) {
       "alternative/delete",
       [&](const MethodCallArgs &args) -> MethodCallResult { return {}; });
 
+  builtinMethodHandlers->setMethodHandler(
+      "alternative/resolve-dependencies",
+      [&](const MethodCallArgs &args) -> MethodCallResult {
+        auto alt =
+            context.findAlternativeById(args.at("id").get<std::string>());
+        if (alt == nullptr) {
+          return {{"error", elp::ErrorCode::NotFound}};
+        }
+
+        auto plan = context.dependencyResolver.resolve(alt);
+        std::vector<std::string> install;
+        for (auto &dependency : plan.install) {
+          install.push_back(dependency->id().str());
+        }
+
+        return {{"install", std::move(install)},
+                {"missing", std::move(plan.missing)}};
+      });
+
+  builtinMethodHandlers->setMethodHandler(
+      "alternative/launch-settings",
+      [&](const MethodCallArgs &args) -> MethodCallResult {
+        auto alt =
+            context.findAlternativeById(args.at("id").get<std::string>());
+        if (alt == nullptr) {
+          return {{"error", elp::ErrorCode::NotFound}};
+        }
+
+        auto title = args.value("title", std::string());
+        return {{"settings", *context.getLaunchSettings(alt, title)}};
+      });
+
   builtinMethodHandlers->setMethodHandler(
       "window/show", [&](const MethodCallArgs &args) -> MethodCallResult {
         auto errorCode = context.showView(args.at("id").get<std::string>());
@@ -0,0 +1,150 @@
+// Compares the round trip latency of the stdio and shm transports:
+//
+//   transport-bench [round trips] [message size]
+//
+// Each transport is measured against a copy of this program that echoes
+// every message back, started with --echo-stdio or --echo-shm=<name>.
+
+#include "ShmTransport.hpp"
+#include "Transport.hpp"
+
+#include <boost/process.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static constexpr std::size_t kDefaultRoundTrips = 100000;
+static constexpr std::size_t kDefaultMessageSize = 64;
+static constexpr std::size_t kWarmupRoundTrips = 1000;
+static constexpr std::string_view kEchoShm = "--echo-shm=";
+
+static std::size_t parseCount(const char *arg, std::size_t defaultValue) {
+  std::string_view text = arg;
+  std::size_t result = 0;
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                   result);
+  if (ec != std::errc{} || ptr != text.data() + text.size() || result == 0) {
+    return defaultValue;
+  }
+
+  return result;
+}
+
+static int echo(Transport &transport) {
+  std::span<char> message;
+  while (transport.receive(message) == std::errc{}) {
+    if (transport.sendMessage(message) != std::errc{}) {
+      return 1;
+    }
+    transport.flush();
+  }
+
+  return 0;
+}
+
+static bool measure(std::string_view name, Transport &transport,
+                    std::size_t roundTrips, std::size_t messageSize) {
+  std::string message(messageSize, 'x');
+  std::vector<double> samples;
+  samples.reserve(roundTrips);
+
+  for (std::size_t i = 0; i < kWarmupRoundTrips + roundTrips; ++i) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::span<char> reply;
+    if (transport.sendMessage(message) != std::errc{}) {
+      std::fprintf(stderr, "%s: send failed\n", name.data());
+      return false;
+    }
+    transport.flush();
+
+    if (transport.receive(reply) != std::errc{} ||
+        std::string_view(reply.data(), reply.size()) != message) {
+      std::fprintf(stderr, "%s: bad echo\n", name.data());
+      return false;
+    }
+
+    if (i >= kWarmupRoundTrips) {
+      samples.push_back(std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+    }
+  }
+
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&](std::size_t percent) {
+    return samples[std::min(samples.size() - 1,
+                            samples.size() * percent / 100)];
+  };
+
+  std::printf("%-6s p50 %8.2f us  p90 %8.2f us  p99 %8.2f us  max %8.2f us\n",
+              name.data(), percentile(50), percentile(90), percentile(99),
+              samples.back());
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1) {
+    std::string_view arg = argv[1];
+
+    if (arg == "--echo-stdio") {
+      std::ios::sync_with_stdio(false);
+      auto transport = createStreamTransport(std::cout, std::cin, std::cin);
+      return echo(*transport);
+    }
+
+    if (arg.starts_with(kEchoShm)) {
+      auto transport =
+          ShmTransport::open(std::string(arg.substr(kEchoShm.size())));
+      return transport != nullptr ? echo(*transport) : 1;
+    }
+  }
+
+  auto roundTrips =
+      argc > 1 ? parseCount(argv[1], kDefaultRoundTrips) : kDefaultRoundTrips;
+  auto messageSize =
+      argc > 2 ? parseCount(argv[2], kDefaultMessageSize) : kDefaultMessageSize;
+  std::string self = argv[0];
+
+  std::printf("%zu round trips of %zu bytes\n", roundTrips, messageSize);
+
+  {
+    boost::process::ipstream out;
+    boost::process::opstream in;
+    boost::process::child child(self, "--echo-stdio",
+                                boost::process::std_out > out,
+                                boost::process::std_in < in);
+
+    auto transport = createStreamTransport(in, out, out);
+    auto ok = measure("stdio", *transport, roundTrips, messageSize);
+    in.pipe().close();
+    child.wait();
+    if (!ok) {
+      return 1;
+    }
+  }
+
+  {
+    auto transport = ShmTransport::create();
+    if (transport == nullptr) {
+      return 1;
+    }
+
+    boost::process::child child(
+        self, std::string(kEchoShm) + transport->getAddress());
+    auto ok = measure("shm", *transport, roundTrips, messageSize);
+    transport->close();
+    child.wait();
+    if (!ok) {
+      return 1;
+    }
+  }
+
+  return 0;
+}